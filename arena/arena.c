@@ -0,0 +1,227 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Region (arena) allocator. Allocations are carved sequentially out of large
+ * blocks and are never freed individually; instead the whole arena is
+ * released at once with arena_reset() or arena_destroy(). This makes
+ * allocating a bump of a pointer and avoids fragmentation for batches of
+ * short-lived objects. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "arena.h"
+
+typedef union {
+	long l;
+	double d;
+	void *p;
+} arena_align;
+
+#define ALIGN sizeof(arena_align)
+#define ROUND(n) (((n) + ALIGN - 1) & ~(ALIGN - 1))
+#define BLOCK_DATA(b) ((char *)(b) + ROUND(sizeof(arena_block)))
+
+/* largest request; anything above would wrap around in ROUND() or when the
+ * block header is added */
+#define ARENA_MAX ((size_t)-1 - ALIGN - ROUND(sizeof(arena_block)))
+
+static arena_block *arena_new_block(arena *a, size_t size)
+{
+	arena_block *b;
+
+	if(size > ARENA_MAX ||
+	   (b = malloc(ROUND(sizeof(arena_block)) + size)) == NULL)
+		return(NULL);
+
+	b->size = size;
+	b->used = 0;
+	a->total += size;
+
+	return(b);
+}
+
+/* create an arena that allocates block_size bytes at a time (0: default) */
+arena *arena_init(size_t block_size)
+{
+	arena *a;
+
+	if(block_size > ARENA_MAX || (a = malloc(sizeof(*a))) == NULL)
+		return(NULL);
+
+	a->block_size = block_size ? ROUND(block_size) : ARENA_BLOCK_SIZE;
+	a->last  = NULL;
+	a->total = 0;
+
+	if((a->head = arena_new_block(a, a->block_size)) == NULL) {
+		free(a);
+		return(NULL);
+	}
+
+	a->head->next = NULL;
+
+	return(a);
+}
+
+/* free the arena and everything allocated from it */
+void arena_destroy(arena *a)
+{
+	arena_block *b;
+
+	assert(a != NULL);
+
+	while((b = a->head) != NULL) {
+		a->head = b->next;
+		free(b);
+	}
+
+	free(a);
+}
+
+/* release everything allocated from the arena at once. The first regular
+ * block is kept for the next batch. */
+void arena_reset(arena *a)
+{
+	arena_block *b, *keep = NULL;
+
+	assert(a != NULL);
+
+	while((b = a->head) != NULL) {
+		a->head = b->next;
+
+		if(keep == NULL && b->size == a->block_size) {
+			keep = b;
+		} else {
+			a->total -= b->size;
+			free(b);
+		}
+	}
+
+	if(keep != NULL) {
+		keep->next = NULL;
+		keep->used = 0;
+	}
+
+	a->head = keep;
+	a->last = NULL;
+}
+
+/* allocate size bytes, suitably aligned for any basic type */
+void *arena_alloc(arena *a, size_t size)
+{
+	arena_block *b;
+
+	assert(a != NULL);
+
+	if(size > ARENA_MAX)
+		return(NULL);
+
+	size = ROUND(size ? size : 1);
+	b = a->head;
+
+	if(b == NULL || b->size - b->used < size) {
+		if(size > a->block_size / 4) {
+			/* big allocations get a block of their own, which is
+			 * linked in behind the current one */
+			if((b = arena_new_block(a, size)) == NULL)
+				return(NULL);
+
+			if(a->head != NULL) {
+				b->next = a->head->next;
+				a->head->next = b;
+			} else {
+				b->next = NULL;
+				a->head = b;
+			}
+		} else {
+			if((b = arena_new_block(a, a->block_size)) == NULL)
+				return(NULL);
+
+			b->next = a->head;
+			a->head = b;
+		}
+	}
+
+	a->last  = BLOCK_DATA(b) + b->used;
+	b->used += size;
+
+	return(a->last);
+}
+
+/* resize p (of old bytes) to size bytes. The most recent allocation grows
+ * in place if there's room, anything else is copied. */
+void *arena_realloc(arena *a, void *p, size_t old, size_t size)
+{
+	arena_block *b;
+	void *d;
+
+	assert(a != NULL);
+
+	if(p == NULL || size > ARENA_MAX)
+		return(p == NULL ? arena_alloc(a, size) : NULL);
+
+	b = a->head;
+
+	if(p == a->last && b != NULL &&
+	   (char *)p >= BLOCK_DATA(b) && (char *)p < BLOCK_DATA(b) + b->size &&
+	   ROUND(size) <= b->size - ((char *)p - BLOCK_DATA(b))) {
+		b->used = ((char *)p - BLOCK_DATA(b)) + ROUND(size);
+		return(p);
+	}
+
+	if(size <= old)
+		return(p);
+
+	if((d = arena_alloc(a, size)) == NULL)
+		return(NULL);
+
+	memcpy(d, p, old);
+
+	return(d);
+}
+
+/* return a null-terminated copy of the first len characters of s */
+char *arena_strndup(arena *a, const char *s, size_t len)
+{
+	char *d;
+
+	assert(s != NULL || len == 0);
+
+	if(len >= ARENA_MAX || (d = arena_alloc(a, len + 1)) == NULL)
+		return(NULL);
+
+	memcpy(d, s, len);
+	d[len] = '\0';
+
+	return(d);
+}
+
+char *arena_strdup(arena *a, const char *s)
+{
+	assert(s != NULL);
+
+	return(arena_strndup(a, s, strlen(s)));
+}
@@ -0,0 +1,53 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#define ARENA_BLOCK_SIZE 65536
+
+typedef struct arena_block_ arena_block;
+struct arena_block_ {
+	arena_block *next;
+	size_t size;
+	size_t used;
+};
+
+typedef struct arena_ {
+	arena_block *head;     /* block currently allocated from */
+	size_t block_size;
+	void *last;            /* most recent allocation */
+	size_t total;          /* bytes of all blocks */
+} arena;
+
+arena *arena_init(size_t block_size);
+void   arena_destroy(arena *a);
+void   arena_reset(arena *a);
+void  *arena_alloc(arena *a, size_t size);
+void  *arena_realloc(arena *a, void *p, size_t old, size_t size);
+char  *arena_strndup(arena *a, const char *s, size_t len);
+char  *arena_strdup(arena *a, const char *s);
+
+#endif  /* ! ARENA_H_ */
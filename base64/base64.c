@@ -25,14 +25,24 @@
 
 /**
  * @file
- * Base64 implementation.
+ * Base64 implementation. This file holds the alphabet tables and the block
+ * kernels; padding, line breaks, whitespace and streaming are left to the
+ * block engine in basen.c, which base64 is plugged into as base64_codec.
  * @ingroup base64
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "base64.h"
+#include "basen.h"
+#include "charclass.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_SIMD 1
+#include <immintrin.h>
+#endif
 
 #define XX 100
 
@@ -88,6 +98,76 @@ static const int base64_index[256] = {
     XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
 };
 
+/* The wide tables below are expanded by the preprocessor, so they need the
+ * alphabet as a constant expression. Both the standard alphabet and the
+ * URL and filename safe one of RFC 4648, which has '-' and '_' for values
+ * 62 and 63, are included; the first index of every table selects it. */
+#define B64_CHR(x, c62, c63) \
+	((x) < 26 ? 'A' + (x) : (x) < 52 ? 'a' + (x) - 26 : \
+	 (x) < 62 ? '0' + (x) - 52 : (x) == 62 ? (c62) : (c63))
+
+#define B64_IDX(c, c62, c63) \
+	((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' : \
+	 (c) >= 'a' && (c) <= 'z' ? (c) - 'a' + 26 : \
+	 (c) >= '0' && (c) <= '9' ? (c) - '0' + 52 : \
+	 (c) == (c62) ? 62 : (c) == (c63) ? 63 : -1)
+
+/* two output characters for each 12 bit value */
+#define B64_PAIR(i, c62, c63) \
+	{ B64_CHR((i) >> 6, c62, c63), B64_CHR((i) & 0x3f, c62, c63) }
+#define B64_PAIR_STD(i) B64_PAIR(i, '+', '/')
+#define B64_PAIR_URL(i) B64_PAIR(i, '-', '_')
+
+static const char base64_pairs[2][4096][2] = {
+	{ BN_R4096(B64_PAIR_STD, 0) },
+	{ BN_R4096(B64_PAIR_URL, 0) }
+};
+
+/* Decoding tables holding the sextet of each character already shifted
+ * into place, so a block is decoded with four lookups and an OR. Characters
+ * outside the alphabet (including '=') set bit 24. */
+#define B64_BAD         0x01000000UL
+#define B64_DEC(c, s, c62, c63) \
+	(B64_IDX(c, c62, c63) < 0 ? B64_BAD : \
+	 (uint32_t)B64_IDX(c, c62, c63) << (s))
+#define B64_DEC0_STD(c) B64_DEC(c, 18, '+', '/')
+#define B64_DEC1_STD(c) B64_DEC(c, 12, '+', '/')
+#define B64_DEC2_STD(c) B64_DEC(c, 6, '+', '/')
+#define B64_DEC3_STD(c) B64_DEC(c, 0, '+', '/')
+#define B64_DEC0_URL(c) B64_DEC(c, 18, '-', '_')
+#define B64_DEC1_URL(c) B64_DEC(c, 12, '-', '_')
+#define B64_DEC2_URL(c) B64_DEC(c, 6, '-', '_')
+#define B64_DEC3_URL(c) B64_DEC(c, 0, '-', '_')
+
+static const uint32_t base64_dec[2][4][256] = {
+	{
+		{ BN_R256(B64_DEC0_STD, 0) },
+		{ BN_R256(B64_DEC1_STD, 0) },
+		{ BN_R256(B64_DEC2_STD, 0) },
+		{ BN_R256(B64_DEC3_STD, 0) }
+	}, {
+		{ BN_R256(B64_DEC0_URL, 0) },
+		{ BN_R256(B64_DEC1_URL, 0) },
+		{ BN_R256(B64_DEC2_URL, 0) },
+		{ BN_R256(B64_DEC3_URL, 0) }
+	}
+};
+
+/* encode three bytes into four characters using the pair table t */
+#define B64_ENCODE3(out, in, t) do { \
+	uint32_t v_ = (uint32_t)(in)[0] << 16 | (uint32_t)(in)[1] << 8 | (in)[2]; \
+	memcpy((out),     (t)[v_ >> 12],    2); \
+	memcpy((out) + 2, (t)[v_ & 0xfff], 2); \
+} while(0)
+
+/* decode four characters into a 24 bit value using the tables t; bit 24 is
+ * set on error */
+#define B64_DECODE4(in, t) \
+	((t)[0][(in)[0]] | (t)[1][(in)[1]] | (t)[2][(in)[2]] | (t)[3][(in)[3]])
+
+/* index into the tables for the given flags */
+#define B64_ALPHABET(flags) (((flags) & BASE64_URLSAFE) ? 1 : 0)
+
 /** Encode a minimal memory block. This function encodes a minimal memory area
  *  of three bytes into a printable base64-format sequence of four bytes.
  *  It is mainly used in more convenient functions, see below.
@@ -104,6 +184,11 @@ static const int base64_index[256] = {
  */
 void base64_encode_block(unsigned char out[4], const unsigned char in[3], int len)
 {
+	if(len == 3) {
+		B64_ENCODE3(out, in, base64_pairs[0]);
+		return;
+	}
+
 	out[0] = base64_list[ in[0] >> 2 ];
 	out[1] = base64_list[ ((in[0] & 0x03) << 4) | ((in[1] & 0xf0) >> 4) ];
 	out[2] = (unsigned char) (len > 1 ? base64_list[ ((in[1] & 0x0f) << 2) | ((in[2] & 0xc0) >> 6) ] : '=');
@@ -127,6 +212,14 @@ int base64_decode_block(unsigned char out[3], const unsigned char in[4])
 {
 	int i, numbytes = 3;
 	char tmp[4];
+	uint32_t v;
+
+	if((v = B64_DECODE4(in, base64_dec[0])) < B64_BAD) {
+		out[0] = (unsigned char)(v >> 16);
+		out[1] = (unsigned char)(v >> 8);
+		out[2] = (unsigned char)v;
+		return(3);
+	}
 
 	for(i = 3; i >= 0; i--) {
 		if(in[i] == '=') {
@@ -176,6 +269,485 @@ size_t base64_decoded_size(size_t len)
 	return((len / 4) * 3);
 }
 
+/* Bulk kernels. They handle as many complete blocks as they can (never the
+ * last few, which might carry padding) and return the number of input bytes
+ * consumed; the rest is left to the scalar code. The decoders stop at the
+ * first vector containing a character outside the alphabet, including '='.
+ * alpha selects the alphabet like B64_ALPHABET() does.
+ * The SIMD kernels are the ones by Wojciech Mula and Daniel Lemire
+ * ("Faster Base64 Encoding and Decoding Using AVX2 Instructions", 2018).
+ * The portable ones use the wide tables above. */
+
+static size_t base64_encode_bulk_scalar(char *out, const unsigned char *in,
+					size_t len, int alpha)
+{
+	size_t i = 0;
+
+	for(; i + 3 <= len; i += 3, out += 4)
+		B64_ENCODE3(out, in + i, base64_pairs[alpha]);
+
+	return(i);
+}
+
+static size_t base64_decode_bulk_scalar(unsigned char *out, const char *in,
+					size_t len, int alpha)
+{
+	const unsigned char *s = (const unsigned char *)in;
+	uint32_t v;
+	size_t i = 0;
+
+	for(; i + 4 <= len; i += 4, out += 3) {
+		if((v = B64_DECODE4(s + i, base64_dec[alpha])) >= B64_BAD)
+			break;
+
+		out[0] = (unsigned char)(v >> 16);
+		out[1] = (unsigned char)(v >> 8);
+		out[2] = (unsigned char)v;
+	}
+
+	return(i);
+}
+
+/* return the number of leading characters of in which are in the alphabet */
+static size_t base64_span_scalar(const char *in, size_t len, int alpha)
+{
+	const uint32_t *t = base64_dec[alpha][3];
+	const unsigned char *s = (const unsigned char *)in;
+	size_t i = 0;
+
+	for(; i + 8 <= len; i += 8)
+		if((t[s[i]]     | t[s[i + 1]] | t[s[i + 2]] | t[s[i + 3]] |
+		    t[s[i + 4]] | t[s[i + 5]] | t[s[i + 6]] | t[s[i + 7]]) >= B64_BAD)
+			break;
+
+	while(i < len && t[s[i]] < B64_BAD)
+		++i;
+
+	return(i);
+}
+
+#ifdef BASE64_SIMD
+
+#define BASE64_SSSE3 __attribute__((target("ssse3")))
+#define BASE64_AVX2  __attribute__((target("avx2")))
+
+/* split 12 bytes (in the low 12 bytes of in) into 16 sextets */
+BASE64_SSSE3 static __m128i base64_enc_reshuffle128(__m128i in)
+{
+	__m128i t0, t1, t2, t3;
+
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+					       4, 5, 3, 4, 1, 2, 0, 1));
+
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+	return(_mm_or_si128(t1, t3));
+}
+
+/* offsets from sextets to characters, indexed as in base64_enc_translate128 */
+BASE64_SSSE3 static __m128i base64_enc_lut128(int alpha)
+{
+	const char c62 = alpha ? '-' : '+', c63 = alpha ? '_' : '/';
+
+	return(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		c62 - 62, c63 - 63, 'A', 0, 0));
+}
+
+/* map sextets to the alphabet by adding a per-range offset */
+BASE64_SSSE3 static __m128i base64_enc_translate128(__m128i in, __m128i lut)
+{
+	__m128i idx;
+
+	idx = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	idx = _mm_or_si128(idx, _mm_and_si128(
+		_mm_cmpgt_epi8(_mm_set1_epi8(26), in), _mm_set1_epi8(13)));
+
+	return(_mm_add_epi8(in, _mm_shuffle_epi8(lut, idx)));
+}
+
+BASE64_SSSE3 static size_t base64_encode_bulk_ssse3(char *out,
+						    const unsigned char *in,
+						    size_t len, int alpha)
+{
+	const __m128i lut = base64_enc_lut128(alpha);
+	__m128i x;
+	size_t i = 0;
+
+	for(; i + 16 <= len; i += 12, out += 16) {
+		x = _mm_loadu_si128((const __m128i *)(in + i));
+		x = base64_enc_translate128(base64_enc_reshuffle128(x), lut);
+		_mm_storeu_si128((__m128i *)out, x);
+	}
+
+	return(i);
+}
+
+/* map the URL safe alphabet to the standard one; returns 0 if in holds
+ * characters of the standard alphabet that the URL safe one lacks */
+BASE64_SSSE3 static int base64_dec_url128(__m128i *in)
+{
+	__m128i x = *in;
+
+	if(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('+')),
+					  _mm_cmpeq_epi8(x, _mm_set1_epi8('/')))))
+		return(0);
+
+	x = _mm_add_epi8(x, _mm_and_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('-')),
+					  _mm_set1_epi8('+' - '-')));
+	x = _mm_add_epi8(x, _mm_and_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('_')),
+					  _mm_set1_epi8('/' - '_')));
+	*in = x;
+
+	return(1);
+}
+
+/* check that all 16 characters are in the alphabet; those of the URL safe
+ * alphabet are mapped to the standard one on the way */
+BASE64_SSSE3 static int base64_valid128(__m128i *in, int alpha)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04,
+		0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i nib = _mm_set1_epi8(0x0f);
+	__m128i hi, lo, x;
+
+	if(alpha && !base64_dec_url128(in))
+		return(0);
+
+	hi = _mm_and_si128(_mm_srli_epi32(*in, 4), nib);
+	lo = _mm_and_si128(*in, nib);
+
+	x = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo),
+			  _mm_shuffle_epi8(lut_hi, hi));
+
+	return(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) == 0xffff);
+}
+
+/* decode 16 characters into 12 bytes (in the low 12 bytes of the result);
+ * returns 0 if a character is not in the alphabet */
+BASE64_SSSE3 static int base64_dec_block128(__m128i in, __m128i *out,
+					    int alpha)
+{
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71,
+		-71, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i hi, roll, x;
+
+	if(!base64_valid128(&in, alpha))
+		return(0);
+
+	hi = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+
+	roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(
+		_mm_cmpeq_epi8(in, _mm_set1_epi8('/')), hi));
+	x = _mm_add_epi8(in, roll);
+
+	x = _mm_maddubs_epi16(x, _mm_set1_epi32(0x01400140));
+	x = _mm_madd_epi16(x, _mm_set1_epi32(0x00011000));
+	*out = _mm_shuffle_epi8(x, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+						 14, 13, 12, -1, -1, -1, -1));
+
+	return(1);
+}
+
+BASE64_SSSE3 static size_t base64_decode_bulk_ssse3(unsigned char *out,
+						    const char *in,
+						    size_t len, int alpha)
+{
+	__m128i x;
+	size_t i = 0;
+
+	/* each store writes 4 bytes beyond its block, so make sure at least
+	 * two more blocks follow */
+	for(; i + 24 <= len; i += 16, out += 12) {
+		x = _mm_loadu_si128((const __m128i *)(in + i));
+
+		if(!base64_dec_block128(x, &x, alpha))
+			break;
+
+		_mm_storeu_si128((__m128i *)out, x);
+	}
+
+	return(i);
+}
+
+BASE64_SSSE3 static size_t base64_span_ssse3(const char *in, size_t len,
+					     int alpha)
+{
+	__m128i x;
+	size_t i = 0;
+
+	for(; i + 16 <= len; i += 16) {
+		x = _mm_loadu_si128((const __m128i *)(in + i));
+
+		if(!base64_valid128(&x, alpha))
+			break;
+	}
+
+	return(i + base64_span_scalar(in + i, len - i, alpha));
+}
+
+BASE64_AVX2 static size_t base64_encode_bulk_avx2(char *out,
+						  const unsigned char *in,
+						  size_t len, int alpha)
+{
+	const __m256i shuf = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+					     4, 5, 3, 4, 1, 2, 0, 1,
+					     10, 11, 9, 10, 7, 8, 6, 7,
+					     4, 5, 3, 4, 1, 2, 0, 1);
+	const __m256i lut = _mm256_broadcastsi128_si256(base64_enc_lut128(alpha));
+	__m256i x, t0, t1, t2, t3, idx;
+	size_t i = 0;
+
+	/* each 128-bit lane takes 12 input bytes */
+	for(; i + 28 <= len; i += 24, out += 32) {
+		x = _mm256_inserti128_si256(_mm256_castsi128_si256(
+			_mm_loadu_si128((const __m128i *)(in + i))),
+			_mm_loadu_si128((const __m128i *)(in + i + 12)), 1);
+
+		x  = _mm256_shuffle_epi8(x, shuf);
+		t0 = _mm256_and_si256(x, _mm256_set1_epi32(0x0fc0fc00));
+		t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		t2 = _mm256_and_si256(x, _mm256_set1_epi32(0x003f03f0));
+		t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		x  = _mm256_or_si256(t1, t3);
+
+		idx = _mm256_subs_epu8(x, _mm256_set1_epi8(51));
+		idx = _mm256_or_si256(idx, _mm256_and_si256(
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(26), x),
+			_mm256_set1_epi8(13)));
+		x = _mm256_add_epi8(x, _mm256_shuffle_epi8(lut, idx));
+
+		_mm256_storeu_si256((__m256i *)out, x);
+	}
+
+	return(i);
+}
+
+/* see base64_valid128() */
+BASE64_AVX2 static int base64_valid256(__m256i *in, int alpha)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+		0x15, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04,
+		0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x01, 0x02, 0x04,
+		0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i nib = _mm256_set1_epi8(0x0f);
+	__m256i x = *in, m;
+
+	if(alpha) {
+		m = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('+')),
+				    _mm256_cmpeq_epi8(x, _mm256_set1_epi8('/')));
+		if(!_mm256_testz_si256(m, m))
+			return(0);
+
+		x = _mm256_add_epi8(x, _mm256_and_si256(
+			_mm256_cmpeq_epi8(x, _mm256_set1_epi8('-')),
+			_mm256_set1_epi8('+' - '-')));
+		x = _mm256_add_epi8(x, _mm256_and_si256(
+			_mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')),
+			_mm256_set1_epi8('/' - '_')));
+		*in = x;
+	}
+
+	return(_mm256_testz_si256(
+		_mm256_shuffle_epi8(lut_lo, _mm256_and_si256(x, nib)),
+		_mm256_shuffle_epi8(lut_hi,
+			_mm256_and_si256(_mm256_srli_epi32(x, 4), nib))));
+}
+
+BASE64_AVX2 static size_t base64_decode_bulk_avx2(unsigned char *out,
+						  const char *in,
+						  size_t len, int alpha)
+{
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71,
+		-71, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m256i x, hi, roll;
+	size_t i = 0;
+
+	/* the store writes 8 bytes beyond the block, so make sure at least
+	 * three more blocks follow */
+	for(; i + 44 <= len; i += 32, out += 24) {
+		x = _mm256_loadu_si256((const __m256i *)(in + i));
+
+		if(!base64_valid256(&x, alpha))
+			break;
+
+		hi = _mm256_and_si256(_mm256_srli_epi32(x, 4),
+				      _mm256_set1_epi8(0x0f));
+
+		roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(
+			_mm256_cmpeq_epi8(x, _mm256_set1_epi8('/')), hi));
+		x = _mm256_add_epi8(x, roll);
+
+		x = _mm256_maddubs_epi16(x, _mm256_set1_epi32(0x01400140));
+		x = _mm256_madd_epi16(x, _mm256_set1_epi32(0x00011000));
+		x = _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		x = _mm256_permutevar8x32_epi32(x,
+			_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+		_mm256_storeu_si256((__m256i *)out, x);
+	}
+
+	return(i + base64_decode_bulk_ssse3(out, in + i, len - i, alpha));
+}
+
+BASE64_AVX2 static size_t base64_span_avx2(const char *in, size_t len,
+					   int alpha)
+{
+	__m256i x;
+	size_t i = 0;
+
+	for(; i + 32 <= len; i += 32) {
+		x = _mm256_loadu_si256((const __m256i *)(in + i));
+
+		if(!base64_valid256(&x, alpha))
+			break;
+	}
+
+	return(i + base64_span_ssse3(in + i, len - i, alpha));
+}
+
+#endif  /* BASE64_SIMD */
+
+static size_t base64_encode_bulk_init(char *, const unsigned char *, size_t,
+				      int);
+static size_t base64_decode_bulk_init(unsigned char *, const char *, size_t,
+				      int);
+static size_t base64_span_init(const char *, size_t, int);
+
+static size_t (*base64_encode_bulk)(char *, const unsigned char *, size_t, int)
+	= base64_encode_bulk_init;
+static size_t (*base64_decode_bulk)(unsigned char *, const char *, size_t, int)
+	= base64_decode_bulk_init;
+static size_t (*base64_span)(const char *, size_t, int) = base64_span_init;
+
+/* pick the kernels for this CPU */
+static void base64_select(void)
+{
+	base64_encode_bulk = base64_encode_bulk_scalar;
+	base64_decode_bulk = base64_decode_bulk_scalar;
+	base64_span        = base64_span_scalar;
+
+#ifdef BASE64_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) {
+		base64_encode_bulk = base64_encode_bulk_avx2;
+		base64_decode_bulk = base64_decode_bulk_avx2;
+		base64_span        = base64_span_avx2;
+	} else if(__builtin_cpu_supports("ssse3")) {
+		base64_encode_bulk = base64_encode_bulk_ssse3;
+		base64_decode_bulk = base64_decode_bulk_ssse3;
+		base64_span        = base64_span_ssse3;
+	}
+#endif
+}
+
+static size_t base64_encode_bulk_init(char *out, const unsigned char *in,
+				      size_t len, int alpha)
+{
+	base64_select();
+	return(base64_encode_bulk(out, in, len, alpha));
+}
+
+static size_t base64_decode_bulk_init(unsigned char *out, const char *in,
+				      size_t len, int alpha)
+{
+	base64_select();
+	return(base64_decode_bulk(out, in, len, alpha));
+}
+
+static size_t base64_span_init(const char *in, size_t len, int alpha)
+{
+	base64_select();
+	return(base64_span(in, len, alpha));
+}
+
+/* Block functions for the engine in basen.c, see basen_codec. */
+
+static size_t base64_encode_blocks(char *out, const unsigned char *in,
+				   size_t n, int alpha)
+{
+	size_t i, len = n * 3;
+
+	i    = base64_encode_bulk(out, in, len, alpha);
+	out += i / 3 * 4;
+
+	for(; i + 3 <= len; i += 3, out += 4)
+		B64_ENCODE3(out, in + i, base64_pairs[alpha]);
+
+	return(n);
+}
+
+static size_t base64_decode_blocks(unsigned char *out, const char *in,
+				   size_t n, int alpha)
+{
+	size_t i, len = n * 4;
+
+	i  = base64_decode_bulk(out, in, len, alpha);
+	i += base64_decode_bulk_scalar(out + i / 4 * 3, in + i, len - i, alpha);
+
+	return(i / 4);
+}
+
+/* encode the last 1-2 bytes of the input; returns the number of characters
+ * written */
+static int base64_encode_last(char *out, const unsigned char *in, int len,
+			      int alpha)
+{
+	unsigned char tmp[3] = { 0, 0, 0 };
+	char blk[4];
+
+	memcpy(tmp, in, len);
+	B64_ENCODE3(blk, tmp, base64_pairs[alpha]);
+	memcpy(out, blk, len + 1);
+
+	return(len + 1);
+}
+
+/* decode the last 2-3 characters of the input; returns the number of bytes
+ * decoded or -1 */
+static int base64_decode_last(unsigned char *out, const char *in, int len,
+			      int alpha)
+{
+	const uint32_t (*t)[256] = base64_dec[alpha];
+	const unsigned char *s = (const unsigned char *)in;
+	uint32_t v;
+
+	if(len < 2 || len > 3)
+	        return(-1);
+
+	v = t[0][s[0]] | t[1][s[1]];
+
+	if(len > 2)
+	        v |= t[2][s[2]];
+
+	if(v >= B64_BAD)
+	        return(-1);
+
+	out[0] = (unsigned char)(v >> 16);
+	if(len > 2)
+	        out[1] = (unsigned char)(v >> 8);
+
+	return(len - 1);
+}
+
+const basen_codec base64_codec = {
+	3, 4, 6, BASE64_LINE_LENGTH, base64_encode_blocks, base64_decode_blocks,
+	base64_encode_last, base64_decode_last
+};
+
 /** Encode an arbitrary size memory area. This function encodes the first
  *  \c len bytes of the contents of the memory area pointed to by \c in and
  *  stores the result in the memory area pointed to by \c out. The result will
@@ -193,20 +765,7 @@ size_t base64_decoded_size(size_t len)
  */
 void base64_encode_binary(char *out, const unsigned char *in, size_t len)
 {
-	int size;
-	size_t i = 0;
-	
-	while(i < len) {
-		size = (len-i < 4) ? len-i : 4;
-		
-		base64_encode_block((unsigned char *)out, in, size);
-
-		out += 4;
-		in  += 3;
-		i   += 3;
-	}
-
-	*out = '\0';
+	basen_encode(BASEN_BASE64, out, in, len, 0);
 }
 
 /** Decode an arbitrary size memory area. This function decodes the
@@ -218,25 +777,46 @@ void base64_encode_binary(char *out, const unsigned char *in, size_t len)
  *
  * @param out pointer to destination
  * @param in pointer to source
- * @returns -1 on error (illegal character) or the number of bytes decoded
+ * @returns -1 on error (illegal character or length) or the number of bytes
+ *          decoded
  *
  * @ingroup base64
  */
 int base64_decode_binary(unsigned char *out, const char *in)
 {
-	size_t len = strlen(in), i = 0;
-	int numbytes = 0;
+	size_t written;
 
-	while(i < len) {
-		if((numbytes += base64_decode_block(out, (unsigned char *)in)) < 0)
-		        return(-1);
+	if(base64_decode_n(out, (size_t)-1, in, strlen(in), &written) < 0)
+	        return(-1);
 
-		out += 3;
-		in  += 4;
-		i   += 4;
-	}
+	return((int)written);
+}
 
-	return(numbytes);
+/** Decode a memory area of known size. This function decodes the first
+ *  \c in_len characters of the memory area pointed to by \c in, which
+ *  doesn't have to be null-terminated, and stores the result in the memory
+ *  area pointed to by \c out. The result will \e not be null-terminated.
+ *
+ *  Unlike base64_decode_binary(), no more than the exact number of decoded
+ *  bytes is written to \c out and nothing is written if that doesn't fit
+ *  into \c out_cap bytes. \c in_len must be a multiple of four and padding
+ *  may only appear at the very end.
+ *
+ * @param out pointer to destination
+ * @param out_cap size of the destination in bytes
+ * @param in pointer to source
+ * @param in_len input size in characters
+ * @param written where to store the number of bytes decoded (may be NULL)
+ * @returns 0 on success, BASE64_ERR_INPUT on malformed input (\c out may
+ *          have been partially written) or BASE64_ERR_SPACE if \c out_cap
+ *          is too small
+ *
+ * @ingroup base64
+ */
+int base64_decode_n(unsigned char *out, size_t out_cap, const char *in,
+		    size_t in_len, size_t *written)
+{
+	return(basen_decode(BASEN_BASE64, out, out_cap, in, in_len, written, 0));
 }
 
 /** Encode a string. This is a convenience function. It encodes the first
@@ -307,3 +887,206 @@ char *base64_decode(const char *in)
 	return(out);
 }
 
+
+/** Check base64 input without decoding it. This function checks the first
+ *  \c in_len characters at \c in, which don't have to be null-terminated, for
+ *  characters outside the alphabet and for misplaced or missing padding,
+ *  using the same rules as base64_decode_ex(), and computes the \e exact
+ *  size of the decoded data. The scan runs at memory speed and doesn't need
+ *  a destination buffer, so bad input can be rejected and good input decoded
+ *  into a buffer of the right size.
+ *
+ * @param in pointer to source
+ * @param in_len input size in characters
+ * @param decoded where to store the decoded size (may be NULL)
+ * @param flags BASE64_URLSAFE, BASE64_NOPAD and BASE64_SKIPWS as for
+ *        base64_decode_ex()
+ * @returns 0 if the input is valid or BASE64_ERR_INPUT
+ *
+ * @ingroup base64
+ */
+int base64_validate(const char *in, size_t in_len, size_t *decoded, int flags)
+{
+	int alpha = B64_ALPHABET(flags);
+	size_t n, chars = 0, pad = 0;
+
+	while(in_len > 0) {
+		if(pad == 0) {
+			n       = base64_span(in, in_len, alpha);
+			chars  += n;
+			in     += n;
+			in_len -= n;
+		}
+
+		while(in_len > 0 && *in == '=') {
+			++pad;
+			++in;
+			--in_len;
+		}
+
+		if(in_len == 0)
+		        break;
+
+		if((flags & BASE64_SKIPWS) == 0 ||
+		   (n = charclass_span(&charclass_space, in, in_len)) == 0)
+		        return(BASE64_ERR_INPUT);
+
+		in     += n;
+		in_len -= n;
+	}
+
+	/* padding completes the last block, without it the last block may
+	 * only be short with BASE64_NOPAD */
+	if(pad > 0 ? (pad > 2 || (chars + pad) % 4 != 0 || chars % 4 < 2)
+		   : (chars % 4 == 1 ||
+		      (chars % 4 != 0 && (flags & BASE64_NOPAD) == 0)))
+	        return(BASE64_ERR_INPUT);
+
+	if(decoded != NULL)
+	        *decoded = chars / 4 * 3 + (chars % 4 ? chars % 4 - 1 : 0);
+
+	return(0);
+}
+
+/** Compute size of needed storage for encoding with options. This function
+ *  computes the \e exact size of the result of base64_encode_ex(), not
+ *  including the terminating null character.
+ *
+ * @param len input size
+ * @param flags encoding options, see base64_encode_ex()
+ * @returns output size
+ *
+ * @ingroup base64
+ */
+size_t base64_encoded_size_ex(size_t len, int flags)
+{
+	return(basen_encoded_size(BASEN_BASE64, len, flags));
+}
+
+/** Encode an arbitrary size memory area with options. This function works
+ *  like base64_encode_binary(), but \c flags may select
+ *  - BASE64_URLSAFE: the URL and filename safe alphabet ('-' and '_' instead
+ *    of '+' and '/'),
+ *  - BASE64_NOPAD: no '=' padding at the end,
+ *  - BASE64_WRAP: a CRLF after every BASE64_LINE_LENGTH characters (but not
+ *    at the end), as required for MIME.
+ *
+ *  The options are applied while encoding, there is no further pass over the
+ *  result.
+ *
+ * @attention \c out must have room for base64_encoded_size_ex() + 1 bytes.
+ *
+ * @param out pointer to destination
+ * @param in pointer to source
+ * @param len input size in bytes
+ * @param flags encoding options
+ * @returns number of characters written, not including the null character
+ *
+ * @ingroup base64
+ */
+size_t base64_encode_ex(char *out, const unsigned char *in, size_t len,
+			int flags)
+{
+	return(basen_encode(BASEN_BASE64, out, in, len, flags));
+}
+
+/** Decode a memory area of known size with options. This function works
+ *  like base64_decode_n(), but \c flags may select
+ *  - BASE64_URLSAFE: the URL and filename safe alphabet,
+ *  - BASE64_NOPAD: accept input that lacks the padding (padded input is
+ *    still accepted), \c in_len need not be a multiple of four then,
+ *  - BASE64_SKIPWS: ignore whitespace anywhere in the input, e.g. the line
+ *    breaks of MIME (BASE64_MIME includes this).
+ *
+ *  Unlike base64_decode_n(), \c out may have been partially written when
+ *  BASE64_ERR_SPACE is returned.
+ *
+ * @param out pointer to destination
+ * @param out_cap size of the destination in bytes
+ * @param in pointer to source
+ * @param in_len input size in characters
+ * @param written where to store the number of bytes decoded (may be NULL)
+ * @param flags decoding options
+ * @returns 0 on success, BASE64_ERR_INPUT on malformed input or
+ *          BASE64_ERR_SPACE if \c out_cap is too small
+ *
+ * @ingroup base64
+ */
+int base64_decode_ex(unsigned char *out, size_t out_cap, const char *in,
+		     size_t in_len, size_t *written, int flags)
+{
+	return(basen_decode(BASEN_BASE64, out, out_cap, in, in_len, written,
+			    flags));
+}
+
+/** Initialize an incremental encoder or decoder. The stream functions let
+ *  you encode or decode data that arrives in chunks of arbitrary size; the
+ *  0-3 bytes which don't make up a complete block are kept in \c st until the
+ *  next call. The state holds no resources, so there's nothing to free.
+ *
+ * @param st pointer to the state
+ * @param mode BASE64_ENCODE or BASE64_DECODE, optionally or'ed with the
+ *        options of base64_encode_ex() or base64_decode_ex()
+ * @returns nothing
+ *
+ * @ingroup base64
+ */
+void base64_stream_init(base64_stream *st, int mode)
+{
+	basen_stream_init(st, BASEN_BASE64, mode);
+}
+
+/** Compute size of needed storage for a stream update. This function
+ *  computes the maximum number of bytes base64_stream_update() writes when
+ *  passed \c len bytes of input. base64_stream_final() writes no more than
+ *  six bytes.
+ *
+ * @param st pointer to the state
+ * @param len input size
+ * @returns output size
+ *
+ * @ingroup base64
+ */
+size_t base64_stream_bound(const base64_stream *st, size_t len)
+{
+	return(basen_stream_bound(st, len));
+}
+
+/** Feed a chunk of input to an incremental encoder or decoder. The output
+ *  is \e not null-terminated.
+ *
+ * @attention \c out must have room for base64_stream_bound() bytes.
+ *
+ * @param st pointer to the state
+ * @param out pointer to destination
+ * @param written where to store the number of bytes written to \c out
+ * @param in pointer to source
+ * @param len input size in bytes
+ * @returns 0 on success or BASE64_ERR_INPUT if the decoder found an illegal
+ *          character or data after the padding
+ *
+ * @ingroup base64
+ */
+int base64_stream_update(base64_stream *st, void *out, size_t *written,
+			 const void *in, size_t len)
+{
+	return(basen_stream_update(st, out, written, in, len));
+}
+
+/** Finish an incremental encoder or decoder. The encoder writes the last
+ *  block (at most six bytes including a line break), the decoder writes
+ *  nothing, or the last 1-2 bytes with BASE64_NOPAD, and fails if the input
+ *  ended in the middle of a block. The state may be reused after calling
+ *  base64_stream_init() again.
+ *
+ * @param st pointer to the state
+ * @param out pointer to destination
+ * @param written where to store the number of bytes written to \c out
+ * @returns 0 on success or BASE64_ERR_INPUT on truncated input
+ *
+ * @ingroup base64
+ */
+int base64_stream_final(base64_stream *st, void *out, size_t *written)
+{
+	return(basen_stream_final(st, out, written));
+}
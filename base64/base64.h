@@ -32,13 +32,45 @@
 #ifndef _BASE64_H
 #define _BASE64_H
 
+#include "basen.h"
+
+#define BASE64_ERR_INPUT BASEN_ERR_INPUT
+#define BASE64_ERR_SPACE BASEN_ERR_SPACE
+
+#define BASE64_ENCODE  BASEN_ENCODE
+#define BASE64_DECODE  BASEN_DECODE
+
+#define BASE64_URLSAFE BASEN_URLSAFE  /* '-' and '_' instead of '+' and '/' */
+#define BASE64_NOPAD   BASEN_NOPAD    /* no (or optional) '=' padding */
+#define BASE64_WRAP    BASEN_WRAP     /* break lines with CRLF */
+#define BASE64_SKIPWS  BASEN_SKIPWS   /* skip whitespace when decoding */
+#define BASE64_MIME    (BASE64_WRAP | BASE64_SKIPWS)
+
+#define BASE64_LINE_LENGTH 76
+
+/** State of an incremental encoder or decoder, see base64_stream_init().
+ *  Base64 runs on the block engine of basen.c, so this is a basen_stream.
+ * @ingroup base64
+ */
+typedef basen_stream base64_stream;
+
 void   base64_encode_block(unsigned char out[4], const unsigned char in[3], int len);
 int    base64_decode_block(unsigned char out[3], const unsigned char in[4]);
 size_t base64_encoded_size(size_t len);
 size_t base64_decoded_size(size_t len);
 void   base64_encode_binary(char *out, const unsigned char *in, size_t len);
 int    base64_decode_binary(unsigned char *out, const char *in);
+int    base64_decode_n(unsigned char *out, size_t out_cap, const char *in, size_t in_len, size_t *written);
+int    base64_validate(const char *in, size_t in_len, size_t *decoded, int flags);
+size_t base64_encoded_size_ex(size_t len, int flags);
+size_t base64_encode_ex(char *out, const unsigned char *in, size_t len, int flags);
+int    base64_decode_ex(unsigned char *out, size_t out_cap, const char *in, size_t in_len, size_t *written, int flags);
 char  *base64_encode(const char *in, size_t size);
 char  *base64_decode(const char *in);
 
+void   base64_stream_init(base64_stream *st, int mode);
+size_t base64_stream_bound(const base64_stream *st, size_t len);
+int    base64_stream_update(base64_stream *st, void *out, size_t *written, const void *in, size_t len);
+int    base64_stream_final(base64_stream *st, void *out, size_t *written);
+
 #endif /* ! _BASE64_H */
@@ -0,0 +1,212 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Parallel base64 encoding and decoding of very large buffers. Every block
+ * of three bytes (four characters) is coded independently, so the input is
+ * cut on block boundaries into one chunk per thread and every thread writes
+ * its part directly to the offset it has in the output.
+ * @ingroup base64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "base64.h"
+#include "base64par.h"
+#include "pool.h"
+
+typedef struct {
+	const unsigned char *in;
+	size_t len;            /* input size */
+	char *out;
+	size_t blocks;         /* blocks per chunk (the last one takes the rest) */
+	size_t nchunks;
+} par_encode_job;
+
+typedef struct {
+	const char *in;
+	size_t len;
+	unsigned char *out;
+	size_t out_cap;
+	size_t blocks;
+	size_t nchunks;
+	size_t last;           /* bytes decoded by the last chunk */
+	int *status;
+} par_decode_job;
+
+/* number of chunks for nblocks blocks of bsize bytes each */
+static size_t par_chunks(size_t nblocks, size_t bsize, size_t nthreads)
+{
+	size_t n;
+
+	if(nthreads == 0)
+	        nthreads = pool_cpus();
+
+	n = nblocks * bsize / BASE64_PAR_MIN_CHUNK;
+	if(n > nthreads)
+	        n = nthreads;
+	if(n == 0)
+	        n = 1;
+
+	return(n);
+}
+
+static void par_encode_chunk(void *arg, size_t i)
+{
+	par_encode_job *j = arg;
+	base64_stream st;
+	size_t written, begin = i * j->blocks * 3;
+
+	if(i + 1 == j->nchunks) {
+		base64_encode_binary(j->out + i * j->blocks * 4, j->in + begin,
+				     j->len - begin);
+		return;
+	}
+
+	/* base64_encode_binary() would put its '\0' on the next chunk */
+	base64_stream_init(&st, BASE64_ENCODE);
+	base64_stream_update(&st, j->out + i * j->blocks * 4, &written,
+			     j->in + begin, j->blocks * 3);
+}
+
+static void par_decode_chunk(void *arg, size_t i)
+{
+	par_decode_job *j = arg;
+	size_t written, begin = i * j->blocks * 4;
+
+	if(i + 1 == j->nchunks) {
+		j->status[i] = base64_decode_n(j->out + i * j->blocks * 3,
+					       j->out_cap - i * j->blocks * 3,
+					       j->in + begin, j->len - begin,
+					       &j->last);
+		return;
+	}
+
+	j->status[i] = base64_decode_n(j->out + i * j->blocks * 3,
+				       j->blocks * 3, j->in + begin,
+				       j->blocks * 4, &written);
+
+	/* padding is only allowed in the last chunk */
+	if(j->status[i] == 0 && written != j->blocks * 3)
+	        j->status[i] = BASE64_ERR_INPUT;
+}
+
+/** Encode an arbitrary size memory area using several threads. This function
+ *  works like base64_encode_binary() but spreads the work over up to
+ *  \c nthreads threads. Buffers smaller than BASE64_PAR_MIN_CHUNK bytes per
+ *  thread are handled by fewer threads; if no thread can be started, the
+ *  calling thread does all of the work.
+ *
+ * @attention This function can't check if there's enough space at the memory
+ *            memory location pointed to by \c out, so be careful.
+ *
+ * @param out pointer to destination
+ * @param in pointer to source
+ * @param len input size in bytes
+ * @param nthreads maximum number of threads (0: one per processor)
+ * @returns nothing
+ *
+ * @ingroup base64
+ */
+void base64_encode_parallel(char *out, const unsigned char *in, size_t len,
+			    size_t nthreads)
+{
+	par_encode_job j;
+	size_t i;
+
+	j.in      = in;
+	j.len     = len;
+	j.out     = out;
+	j.nchunks = par_chunks(len / 3, 3, nthreads);
+	j.blocks  = len / 3 / j.nchunks;
+
+	if(pool_run(j.nchunks, nthreads, par_encode_chunk, &j) < 0)
+		for(i = 0; i < j.nchunks; i++)
+		        par_encode_chunk(&j, i);
+}
+
+/** Decode a memory area of known size using several threads. This function
+ *  works like base64_decode_n(), including the capacity check, but spreads
+ *  the work over up to \c nthreads threads.
+ *
+ * @param out pointer to destination
+ * @param out_cap size of the destination in bytes
+ * @param in pointer to source
+ * @param in_len input size in characters
+ * @param written where to store the number of bytes decoded (may be NULL)
+ * @param nthreads maximum number of threads (0: one per processor)
+ * @returns 0 on success, BASE64_ERR_INPUT on malformed input or
+ *          BASE64_ERR_SPACE if \c out_cap is too small
+ *
+ * @ingroup base64
+ */
+int base64_decode_parallel(unsigned char *out, size_t out_cap, const char *in,
+			   size_t in_len, size_t *written, size_t nthreads)
+{
+	par_decode_job j;
+	size_t i, size;
+	int ret = 0;
+
+	if(in_len % 4 != 0)
+	        return(BASE64_ERR_INPUT);
+
+	/* check the capacity before any thread writes to out */
+	size = in_len / 4 * 3;
+	if(in_len > 0 && in[in_len - 1] == '=')
+	        size -= (in[in_len - 2] == '=') ? 2 : 1;
+
+	if(size > out_cap)
+	        return(BASE64_ERR_SPACE);
+
+	j.in      = in;
+	j.len     = in_len;
+	j.out     = out;
+	j.out_cap = out_cap;
+	j.nchunks = par_chunks(in_len / 4, 4, nthreads);
+	j.blocks  = in_len / 4 / j.nchunks;
+
+	if(j.nchunks == 1)
+	        return(base64_decode_n(out, out_cap, in, in_len, written));
+
+	if((j.status = malloc(j.nchunks * sizeof(*j.status))) == NULL)
+	        return(base64_decode_n(out, out_cap, in, in_len, written));
+
+	if(pool_run(j.nchunks, nthreads, par_decode_chunk, &j) < 0)
+		for(i = 0; i < j.nchunks; i++)
+		        par_decode_chunk(&j, i);
+
+	for(i = 0; i < j.nchunks; i++)
+		if(j.status[i] < 0)
+		        ret = j.status[i];
+
+	free(j.status);
+
+	if(ret == 0 && written != NULL)
+	        *written = (j.nchunks - 1) * j.blocks * 3 + j.last;
+
+	return(ret);
+}
@@ -0,0 +1,171 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Base64 encoding and decoding of whole files. The input is read in blocks
+ * of BASE64_STREAM_BLOCK_SIZE bytes and run through an incremental
+ * encoder or decoder, so memory use is constant regardless of the file size.
+ * @ingroup base64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "base64.h"
+#include "base64stream.h"
+#include "fileio.h"
+
+typedef struct {
+	long (*read)(void *ctx, void *buf, size_t len);
+	int  (*write)(void *ctx, const void *buf, size_t len);
+	void *in;
+	void *out;
+} base64_io;
+
+static int base64_convert(base64_io *io, int mode)
+{
+	base64_stream st;
+	unsigned char *in, *out;
+	size_t written;
+	long n;
+	int ret = -1;
+
+	base64_stream_init(&st, mode);
+
+	in  = malloc(BASE64_STREAM_BLOCK_SIZE);
+	out = malloc(base64_stream_bound(&st, BASE64_STREAM_BLOCK_SIZE) + 4);
+
+	if(in == NULL || out == NULL)
+		goto out;
+
+	while((n = io->read(io->in, in, BASE64_STREAM_BLOCK_SIZE)) > 0) {
+		if(base64_stream_update(&st, out, &written, in, n) < 0 ||
+		   io->write(io->out, out, written) < 0)
+			goto out;
+	}
+
+	if(n < 0 || base64_stream_final(&st, out, &written) < 0 ||
+	   io->write(io->out, out, written) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	free(in);
+	free(out);
+
+	return(ret);
+}
+
+/** Encode a file. This function reads \c in up to its end and writes the
+ *  base64-encoded contents to \c out, without any line breaks unless
+ *  \c BASE64_WRAP is given.
+ *
+ * @param out destination stream
+ * @param in source stream
+ * @param flags \c BASE64_URLSAFE, \c BASE64_NOPAD, \c BASE64_WRAP or 0
+ * @returns -1 on error (I/O error or not enough memory) or 0
+ *
+ * @ingroup base64
+ */
+int base64_encode_stream(FILE *out, FILE *in, int flags)
+{
+	base64_io io;
+
+	io.read  = file_read_block;
+	io.write = file_write_block;
+	io.in    = in;
+	io.out   = out;
+
+	return(base64_convert(&io, BASE64_ENCODE | (flags & ~BASE64_DECODE)));
+}
+
+/** Decode a file. This function reads \c in up to its end and writes the
+ *  decoded contents to \c out. On malformed input, whatever has been decoded
+ *  up to that point has already been written. The output of base64(1) and
+ *  other line-wrapped input needs \c BASE64_SKIPWS.
+ *
+ * @param out destination stream
+ * @param in source stream
+ * @param flags \c BASE64_URLSAFE, \c BASE64_NOPAD, \c BASE64_SKIPWS or 0
+ * @returns -1 on error (illegal character, truncated input, I/O error or not
+ *          enough memory) or 0
+ *
+ * @ingroup base64
+ */
+int base64_decode_stream(FILE *out, FILE *in, int flags)
+{
+	base64_io io;
+
+	io.read  = file_read_block;
+	io.write = file_write_block;
+	io.in    = in;
+	io.out   = out;
+
+	return(base64_convert(&io, BASE64_DECODE | flags));
+}
+
+/** Encode a file descriptor. Same as base64_encode_stream(), but on file
+ *  descriptors.
+ *
+ * @param out destination descriptor
+ * @param in source descriptor
+ * @param flags as for base64_encode_stream()
+ * @returns -1 on error or 0
+ *
+ * @ingroup base64
+ */
+int base64_encode_fd(int out, int in, int flags)
+{
+	base64_io io;
+
+	io.read  = file_read_block_fd;
+	io.write = file_write_block_fd;
+	io.in    = &in;
+	io.out   = &out;
+
+	return(base64_convert(&io, BASE64_ENCODE | (flags & ~BASE64_DECODE)));
+}
+
+/** Decode a file descriptor. Same as base64_decode_stream(), but on file
+ *  descriptors.
+ *
+ * @param out destination descriptor
+ * @param in source descriptor
+ * @param flags as for base64_decode_stream()
+ * @returns -1 on error or 0
+ *
+ * @ingroup base64
+ */
+int base64_decode_fd(int out, int in, int flags)
+{
+	base64_io io;
+
+	io.read  = file_read_block_fd;
+	io.write = file_write_block_fd;
+	io.in    = &in;
+	io.out   = &out;
+
+	return(base64_convert(&io, BASE64_DECODE | flags));
+}
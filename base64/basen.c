@@ -0,0 +1,1054 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Base16 and Base32 implementation (RFC 4648) and the block engine shared
+ * with base64.c. A codec (see basen_codec) turns blocks of \c ibytes input
+ * bytes into \c ochars characters; the engine feeds it complete blocks,
+ * deals with the last, possibly short and padded block, carries incomplete
+ * blocks from one stream update to the next, breaks lines and skips
+ * whitespace. As in base64.c, every codec has portable table-driven block
+ * functions; base16, the one used for bulk hex dumps, has SSSE3 and AVX2
+ * kernels as well.
+ * @ingroup base64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "basen.h"
+#include "charclass.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASEN_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* set in decoding table entries of characters outside the alphabet */
+#define BN_BAD 0x00100000UL
+
+/* Base16: one byte per block, two characters for each byte. The decoder
+ * accepts both cases. */
+#define B16_CHR(x, up) ((x) < 10 ? '0' + (x) : ((up) ? 'A' : 'a') + (x) - 10)
+
+#define B16_IDX(c) \
+	((c) >= '0' && (c) <= '9' ? (c) - '0' : \
+	 (c) >= 'a' && (c) <= 'f' ? (c) - 'a' + 10 : \
+	 (c) >= 'A' && (c) <= 'F' ? (c) - 'A' + 10 : -1)
+
+#define B16_PAIR(i, up) { B16_CHR((i) >> 4, up), B16_CHR((i) & 0x0f, up) }
+#define B16_PAIR_LO(i)  B16_PAIR(i, 0)
+#define B16_PAIR_UP(i)  B16_PAIR(i, 1)
+
+static const char base16_pairs[2][256][2] = {
+	{ BN_R256(B16_PAIR_LO, 0) },
+	{ BN_R256(B16_PAIR_UP, 0) }
+};
+
+#define B16_DEC(c, s) (B16_IDX(c) < 0 ? BN_BAD : (uint32_t)B16_IDX(c) << (s))
+#define B16_DEC0(c)   B16_DEC(c, 4)
+#define B16_DEC1(c)   B16_DEC(c, 0)
+
+static const uint32_t base16_dec[2][256] = {
+	{ BN_R256(B16_DEC0, 0) },
+	{ BN_R256(B16_DEC1, 0) }
+};
+
+/* Base32: five bytes per block, eight characters. The encoding tables hold
+ * two characters for every 10 bit value, the decoding tables the value of
+ * a character shifted into its place within half a block (20 bits). The
+ * decoder accepts both cases. */
+#define B32_CHR(x, hex) \
+	((hex) ? ((x) < 10 ? '0' + (x) : 'A' + (x) - 10) \
+	       : ((x) < 26 ? 'A' + (x) : '2' + (x) - 26))
+
+#define B32_IDX(c, hex) \
+	((hex) ? ((c) >= '0' && (c) <= '9' ? (c) - '0' : \
+		  (c) >= 'A' && (c) <= 'V' ? (c) - 'A' + 10 : \
+		  (c) >= 'a' && (c) <= 'v' ? (c) - 'a' + 10 : -1) \
+	       : ((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' : \
+		  (c) >= 'a' && (c) <= 'z' ? (c) - 'a' : \
+		  (c) >= '2' && (c) <= '7' ? (c) - '2' + 26 : -1))
+
+#define B32_PAIR(i, hex) { B32_CHR((i) >> 5, hex), B32_CHR((i) & 0x1f, hex) }
+#define B32_PAIR_STD(i)  B32_PAIR(i, 0)
+#define B32_PAIR_HEX(i)  B32_PAIR(i, 1)
+
+static const char base32_pairs[2][1024][2] = {
+	{ BN_R1024(B32_PAIR_STD, 0) },
+	{ BN_R1024(B32_PAIR_HEX, 0) }
+};
+
+#define B32_DEC(c, s, hex) \
+	(B32_IDX(c, hex) < 0 ? BN_BAD : (uint32_t)B32_IDX(c, hex) << (s))
+#define B32_DEC0_STD(c) B32_DEC(c, 15, 0)
+#define B32_DEC1_STD(c) B32_DEC(c, 10, 0)
+#define B32_DEC2_STD(c) B32_DEC(c, 5, 0)
+#define B32_DEC3_STD(c) B32_DEC(c, 0, 0)
+#define B32_DEC0_HEX(c) B32_DEC(c, 15, 1)
+#define B32_DEC1_HEX(c) B32_DEC(c, 10, 1)
+#define B32_DEC2_HEX(c) B32_DEC(c, 5, 1)
+#define B32_DEC3_HEX(c) B32_DEC(c, 0, 1)
+
+static const uint32_t base32_dec[2][4][256] = {
+	{
+		{ BN_R256(B32_DEC0_STD, 0) },
+		{ BN_R256(B32_DEC1_STD, 0) },
+		{ BN_R256(B32_DEC2_STD, 0) },
+		{ BN_R256(B32_DEC3_STD, 0) }
+	}, {
+		{ BN_R256(B32_DEC0_HEX, 0) },
+		{ BN_R256(B32_DEC1_HEX, 0) },
+		{ BN_R256(B32_DEC2_HEX, 0) },
+		{ BN_R256(B32_DEC3_HEX, 0) }
+	}
+};
+
+/* decode four characters into 20 bits; BN_BAD is set on error */
+#define B32_DECODE4(s, t) \
+	((t)[0][(s)[0]] | (t)[1][(s)[1]] | (t)[2][(s)[2]] | (t)[3][(s)[3]])
+
+/* number of bytes encoded by a short last block of n base32 characters */
+static const int base32_short[8] = { -1, -1, 1, -1, 2, 3, -1, 4 };
+
+/* Portable block functions. The decoders stop at the first block holding
+ * a character outside the alphabet and return the number of blocks
+ * decoded. alpha selects the table (upper case for base16, base32hex for
+ * base32). */
+
+static size_t base16_encode_scalar(char *out, const unsigned char *in,
+				   size_t n, int alpha)
+{
+	const char (*t)[2] = base16_pairs[alpha];
+	size_t i;
+
+	for(i = 0; i < n; i++)
+		memcpy(out + 2 * i, t[in[i]], 2);
+
+	return(n);
+}
+
+static size_t base16_decode_scalar(unsigned char *out, const char *in,
+				   size_t n)
+{
+	const unsigned char *s = (const unsigned char *)in;
+	uint32_t v;
+	size_t i;
+
+	for(i = 0; i < n; i++, s += 2) {
+		if((v = base16_dec[0][s[0]] | base16_dec[1][s[1]]) >= BN_BAD)
+			break;
+
+		out[i] = (unsigned char)v;
+	}
+
+	return(i);
+}
+
+static size_t base32_encode_blocks(char *out, const unsigned char *in,
+				   size_t n, int alpha)
+{
+	const char (*t)[2] = base32_pairs[alpha];
+	uint64_t v;
+	size_t i;
+
+	for(i = 0; i < n; i++, in += 5, out += 8) {
+		v = (uint64_t)in[0] << 32 | (uint64_t)in[1] << 24 |
+		    (uint64_t)in[2] << 16 | (uint64_t)in[3] << 8 | in[4];
+
+		memcpy(out,     t[v >> 30],            2);
+		memcpy(out + 2, t[(v >> 20) & 0x3ff], 2);
+		memcpy(out + 4, t[(v >> 10) & 0x3ff], 2);
+		memcpy(out + 6, t[v & 0x3ff],          2);
+	}
+
+	return(n);
+}
+
+static size_t base32_decode_blocks(unsigned char *out, const char *in,
+				   size_t n, int alpha)
+{
+	const uint32_t (*t)[256] = base32_dec[alpha];
+	const unsigned char *s = (const unsigned char *)in;
+	uint32_t hi, lo;
+	uint64_t v;
+	size_t i;
+
+	for(i = 0; i < n; i++, s += 8, out += 5) {
+		hi = B32_DECODE4(s, t);
+		lo = B32_DECODE4(s + 4, t);
+
+		if((hi | lo) >= BN_BAD)
+			break;
+
+		v = (uint64_t)hi << 20 | lo;
+		out[0] = (unsigned char)(v >> 32);
+		out[1] = (unsigned char)(v >> 24);
+		out[2] = (unsigned char)(v >> 16);
+		out[3] = (unsigned char)(v >> 8);
+		out[4] = (unsigned char)v;
+	}
+
+	return(i);
+}
+
+/* encode a short last block of len bytes, without padding; returns the
+ * number of characters written */
+static int base32_encode_last(char *out, const unsigned char *in, int len,
+			      int alpha)
+{
+	unsigned char tmp[5] = { 0, 0, 0, 0, 0 };
+	char blk[8];
+	int n = (len * 8 + 4) / 5;
+
+	memcpy(tmp, in, len);
+	base32_encode_blocks(blk, tmp, 1, alpha);
+	memcpy(out, blk, n);
+
+	return(n);
+}
+
+/* decode a short last block of len characters (padding removed); returns
+ * the number of bytes decoded or -1 */
+static int base32_decode_last(unsigned char *out, const char *in, int len,
+			      int alpha)
+{
+	unsigned char tmp[5];
+	char blk[8];
+	int n;
+
+	if(len < 1 || len > 7 || (n = base32_short[len]) < 0)
+	        return(-1);
+
+	memset(blk, B32_CHR(0, alpha), sizeof(blk));
+	memcpy(blk, in, len);
+
+	if(base32_decode_blocks(tmp, blk, 1, alpha) != 1)
+	        return(-1);
+
+	memcpy(out, tmp, n);
+
+	return(n);
+}
+
+#ifdef BASEN_SIMD
+
+#define BASEN_SSSE3 __attribute__((target("ssse3")))
+#define BASEN_AVX2  __attribute__((target("avx2")))
+
+/* Base16 kernels. Encoding looks the nibbles up with pshufb and interleaves
+ * them; decoding maps digits and letters to their values with two range
+ * checks and joins pairs of nibbles with pmaddubsw. */
+
+BASEN_SSSE3 static __m128i base16_lut128(int alpha)
+{
+	return(alpha ? _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+				     '8', '9', 'A', 'B', 'C', 'D', 'E', 'F')
+		     : _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+				     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'));
+}
+
+BASEN_SSSE3 static size_t base16_encode_ssse3(char *out,
+					      const unsigned char *in,
+					      size_t n, int alpha)
+{
+	const __m128i lut = base16_lut128(alpha);
+	const __m128i nib = _mm_set1_epi8(0x0f);
+	__m128i x, hi, lo;
+	size_t i = 0;
+
+	for(; i + 16 <= n; i += 16) {
+		x  = _mm_loadu_si128((const __m128i *)(in + i));
+		hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), nib));
+		lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, nib));
+
+		_mm_storeu_si128((__m128i *)(out + 2 * i),
+				 _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(out + 2 * i + 16),
+				 _mm_unpackhi_epi8(hi, lo));
+	}
+
+	return(i + base16_encode_scalar(out + 2 * i, in + i, n - i, alpha));
+}
+
+/* nibble values of 16 hex digits; returns 0 if one isn't a hex digit */
+BASEN_SSSE3 static int base16_nibbles128(__m128i *x)
+{
+	__m128i d, l, isd, isl;
+
+	d   = _mm_sub_epi8(*x, _mm_set1_epi8('0'));
+	l   = _mm_sub_epi8(_mm_or_si128(*x, _mm_set1_epi8(0x20)),
+			   _mm_set1_epi8('a'));
+	isd = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+	isl = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+
+	if(_mm_movemask_epi8(_mm_or_si128(isd, isl)) != 0xffff)
+		return(0);
+
+	*x = _mm_or_si128(_mm_and_si128(isd, d),
+			  _mm_and_si128(isl, _mm_add_epi8(l, _mm_set1_epi8(10))));
+
+	return(1);
+}
+
+BASEN_SSSE3 static size_t base16_decode_ssse3(unsigned char *out,
+					      const char *in, size_t n)
+{
+	const __m128i mul = _mm_set1_epi16(0x0110);
+	__m128i a, b;
+	size_t i = 0;
+
+	for(; i + 16 <= n; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+		b = _mm_loadu_si128((const __m128i *)(in + 2 * i + 16));
+
+		if(!base16_nibbles128(&a) || !base16_nibbles128(&b))
+			break;
+
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(
+			_mm_maddubs_epi16(a, mul), _mm_maddubs_epi16(b, mul)));
+	}
+
+	return(i + base16_decode_scalar(out + i, in + 2 * i, n - i));
+}
+
+BASEN_AVX2 static size_t base16_encode_avx2(char *out, const unsigned char *in,
+					    size_t n, int alpha)
+{
+	const __m256i lut = _mm256_broadcastsi128_si256(base16_lut128(alpha));
+	const __m256i nib = _mm256_set1_epi8(0x0f);
+	__m256i x, hi, lo, a, b;
+	size_t i = 0;
+
+	for(; i + 32 <= n; i += 32) {
+		x  = _mm256_loadu_si256((const __m256i *)(in + i));
+		hi = _mm256_shuffle_epi8(lut,
+			_mm256_and_si256(_mm256_srli_epi16(x, 4), nib));
+		lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, nib));
+
+		/* unpacking works within lanes, put the halves back in order */
+		a = _mm256_unpacklo_epi8(hi, lo);
+		b = _mm256_unpackhi_epi8(hi, lo);
+
+		_mm256_storeu_si256((__m256i *)(out + 2 * i),
+				    _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(out + 2 * i + 32),
+				    _mm256_permute2x128_si256(a, b, 0x31));
+	}
+
+	return(i + base16_encode_ssse3(out + 2 * i, in + i, n - i, alpha));
+}
+
+/* see base16_nibbles128() */
+BASEN_AVX2 static int base16_nibbles256(__m256i *x)
+{
+	__m256i d, l, isd, isl;
+
+	d   = _mm256_sub_epi8(*x, _mm256_set1_epi8('0'));
+	l   = _mm256_sub_epi8(_mm256_or_si256(*x, _mm256_set1_epi8(0x20)),
+			      _mm256_set1_epi8('a'));
+	isd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+	isl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+
+	if(_mm256_movemask_epi8(_mm256_or_si256(isd, isl)) != -1)
+		return(0);
+
+	*x = _mm256_or_si256(_mm256_and_si256(isd, d),
+		_mm256_and_si256(isl, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+
+	return(1);
+}
+
+BASEN_AVX2 static size_t base16_decode_avx2(unsigned char *out,
+					    const char *in, size_t n)
+{
+	const __m256i mul = _mm256_set1_epi16(0x0110);
+	__m256i a, b;
+	size_t i = 0;
+
+	for(; i + 32 <= n; i += 32) {
+		a = _mm256_loadu_si256((const __m256i *)(in + 2 * i));
+		b = _mm256_loadu_si256((const __m256i *)(in + 2 * i + 32));
+
+		if(!base16_nibbles256(&a) || !base16_nibbles256(&b))
+			break;
+
+		/* packing works within lanes, too */
+		a = _mm256_packus_epi16(_mm256_maddubs_epi16(a, mul),
+					_mm256_maddubs_epi16(b, mul));
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_permute4x64_epi64(a, 0xd8));
+	}
+
+	return(i + base16_decode_ssse3(out + i, in + 2 * i, n - i));
+}
+
+#endif  /* BASEN_SIMD */
+
+static size_t base16_encode_init(char *, const unsigned char *, size_t, int);
+static size_t base16_decode_init(unsigned char *, const char *, size_t);
+
+static size_t (*base16_encode_bulk)(char *, const unsigned char *, size_t, int)
+	= base16_encode_init;
+static size_t (*base16_decode_bulk)(unsigned char *, const char *, size_t)
+	= base16_decode_init;
+
+/* pick the kernels for this CPU */
+static void basen_select(void)
+{
+	base16_encode_bulk = base16_encode_scalar;
+	base16_decode_bulk = base16_decode_scalar;
+
+#ifdef BASEN_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) {
+		base16_encode_bulk = base16_encode_avx2;
+		base16_decode_bulk = base16_decode_avx2;
+	} else if(__builtin_cpu_supports("ssse3")) {
+		base16_encode_bulk = base16_encode_ssse3;
+		base16_decode_bulk = base16_decode_ssse3;
+	}
+#endif
+}
+
+static size_t base16_encode_init(char *out, const unsigned char *in,
+				 size_t n, int alpha)
+{
+	basen_select();
+	return(base16_encode_bulk(out, in, n, alpha));
+}
+
+static size_t base16_decode_init(unsigned char *out, const char *in, size_t n)
+{
+	basen_select();
+	return(base16_decode_bulk(out, in, n));
+}
+
+static size_t base16_encode_blocks(char *out, const unsigned char *in,
+				   size_t n, int alpha)
+{
+	return(base16_encode_bulk(out, in, n, alpha));
+}
+
+static size_t base16_decode_blocks(unsigned char *out, const char *in,
+				   size_t n, int alpha)
+{
+	(void)alpha;
+
+	return(base16_decode_bulk(out, in, n));
+}
+
+static const basen_codec base16_codec = {
+	1, 2, 4, 0, base16_encode_blocks, base16_decode_blocks,
+	NULL, NULL      /* no short blocks */
+};
+
+static const basen_codec base32_codec = {
+	5, 8, 5, 0, base32_encode_blocks, base32_decode_blocks,
+	base32_encode_last, base32_decode_last
+};
+
+static const basen_codec *const basen_codecs[] = {
+	&base16_codec,  /* BASEN_BASE16 */
+	&base32_codec,  /* BASEN_BASE32 */
+	&base32_codec,  /* BASEN_BASE32HEX */
+	&base64_codec   /* BASEN_BASE64 */
+};
+
+/* table index for codec and flags */
+static int basen_alpha(int codec, int flags)
+{
+	switch(codec) {
+	case BASEN_BASE16:
+		return((flags & BASEN_UPPER) ? 1 : 0);
+	case BASEN_BASE64:
+		return((flags & BASEN_URLSAFE) ? 1 : 0);
+	default:
+		return(codec == BASEN_BASE32HEX);
+	}
+}
+
+/* nonzero if the encoder breaks lines */
+#define BASEN_WRAPS(c, mode) (((mode) & BASEN_WRAP) && (c)->line > 0)
+
+/* encode a short last block of len bytes, padded unless BASEN_NOPAD is
+ * set; returns the number of characters written */
+static int basen_encode_last(const basen_codec *c, char *out,
+			     const unsigned char *in, int len, int alpha,
+			     int flags)
+{
+	int n;
+
+	/* the input of a codec without short blocks never leaves one */
+	assert(c->encode_last != NULL);
+
+	n = c->encode_last(out, in, len, alpha);
+
+	if((flags & BASEN_NOPAD) == 0)
+		for(; n < c->ochars; n++)
+		        out[n] = '=';
+
+	return(n);
+}
+
+/* decode a short last block of len characters (padding removed); returns
+ * the number of bytes or -1 */
+static int basen_decode_last(const basen_codec *c, unsigned char *out,
+			     const char *in, int len, int alpha)
+{
+	/* a codec without short blocks has no valid ones either */
+	if(c->decode_last == NULL)
+	        return(-1);
+
+	return(c->decode_last(out, in, len, alpha));
+}
+
+/* decode a block which didn't decode as a whole, which is fine if it is
+ * a properly padded last block; returns the number of bytes or -1 */
+static int basen_decode_padded(const basen_codec *c, unsigned char *out,
+			       const char *in, int alpha)
+{
+	int n = c->ochars;
+
+	while(n > 0 && in[n - 1] == '=')
+	        --n;
+
+	if(n == c->ochars)
+	        return(-1);
+
+	return(basen_decode_last(c, out, in, n, alpha));
+}
+
+/** Compute size of needed storage for encoding. This function computes the
+ *  \e exact size of the result of basen_encode(), not including the
+ *  terminating null character.
+ *
+ * @param codec BASEN_BASE16, BASEN_BASE32, BASEN_BASE32HEX or BASEN_BASE64
+ * @param len input size
+ * @param flags encoding options, see basen_encode()
+ * @returns output size
+ *
+ * @ingroup base64
+ */
+size_t basen_encoded_size(int codec, size_t len, int flags)
+{
+	const basen_codec *c = basen_codecs[codec];
+	size_t rem = len % c->ibytes;
+
+	len = len / c->ibytes * c->ochars;
+
+	if(rem > 0)
+	        len += (flags & BASEN_NOPAD) ? (rem * 8 + c->bits - 1) / c->bits
+					     : (size_t)c->ochars;
+
+	if(BASEN_WRAPS(c, flags) && len > 0)
+	        len += (len - 1) / c->line * 2;
+
+	return(len);
+}
+
+/** Compute size of needed storage for decoding. This function computes the
+ *  maximum size of the result of basen_decode() for \c len characters of
+ *  input, which is exact for base16 and unpadded input without whitespace.
+ *
+ * @param codec BASEN_BASE16, BASEN_BASE32, BASEN_BASE32HEX or BASEN_BASE64
+ * @param len input size
+ * @returns output size
+ *
+ * @ingroup base64
+ */
+size_t basen_decoded_size(int codec, size_t len)
+{
+	const basen_codec *c = basen_codecs[codec];
+
+	return(len / 8 * c->bits + len % 8 * c->bits / 8);
+}
+
+/** Encode an arbitrary size memory area. This function encodes the first
+ *  \c len bytes at \c in and stores the null-terminated result at \c out.
+ *  \c flags may hold
+ *  - BASEN_UPPER: use upper case hex digits (base16; base32 always uses
+ *    upper case),
+ *  - BASEN_URLSAFE: the URL and filename safe alphabet (base64),
+ *  - BASEN_NOPAD: no '=' padding at the end (base32, base64),
+ *  - BASEN_WRAP: a CRLF after every BASE64_LINE_LENGTH characters, but not
+ *    at the end (base64).
+ *
+ * @attention \c out must have room for basen_encoded_size() + 1 bytes.
+ *
+ * @param codec BASEN_BASE16, BASEN_BASE32, BASEN_BASE32HEX or BASEN_BASE64
+ * @param out pointer to destination
+ * @param in pointer to source
+ * @param len input size in bytes
+ * @param flags encoding options
+ * @returns number of characters written, not including the null character
+ *
+ * @ingroup base64
+ */
+size_t basen_encode(int codec, char *out, const unsigned char *in, size_t len,
+		    int flags)
+{
+	const basen_codec *c = basen_codecs[codec];
+	int alpha = basen_alpha(codec, flags);
+	basen_stream st;
+	size_t n, m;
+
+	/* line breaks need the stream's column */
+	if(BASEN_WRAPS(c, flags)) {
+		basen_stream_init(&st, codec,
+				  BASEN_ENCODE | (flags & ~BASEN_DECODE));
+		basen_stream_update(&st, out, &n, in, len);
+		basen_stream_final(&st, out + n, &m);
+
+		out[n + m] = '\0';
+
+		return(n + m);
+	}
+
+	n = len / c->ibytes;
+	c->encode(out, in, n, alpha);
+	m = n * c->ochars;
+
+	if(len % c->ibytes)
+	        m += basen_encode_last(c, out + m, in + n * c->ibytes,
+				       (int)(len % c->ibytes), alpha, flags);
+
+	out[m] = '\0';
+
+	return(m);
+}
+
+/* basen_decode() for input with whitespace: run it through a stream,
+ * feeding the input block by block via tmp close to out_cap */
+static int basen_decode_ws(int codec, unsigned char *out, size_t out_cap,
+			   const char *in, size_t in_len, size_t *written,
+			   int flags)
+{
+	const basen_codec *c = basen_codecs[codec];
+	basen_stream st;
+	unsigned char tmp[8];
+	size_t n, w, room, total = 0;
+	int ret;
+
+	basen_stream_init(&st, codec, BASEN_DECODE | flags);
+
+	while(in_len > 0) {
+		room = out_cap - total;
+		n    = in_len;
+
+		if(basen_stream_bound(&st, n) > room) {
+			n = room / c->ibytes * c->ochars;
+			n = (n > (size_t)st.len) ? n - st.len : 0;
+		}
+
+		if(n > 0) {
+			if((ret = basen_stream_update(&st, out + total, &w,
+						      in, n)) < 0)
+			        return(ret);
+		} else {
+			n = (in_len < (size_t)c->ochars) ? in_len
+							 : (size_t)c->ochars;
+
+			if((ret = basen_stream_update(&st, tmp, &w, in, n)) < 0)
+			        return(ret);
+			if(w > room)
+			        return(BASEN_ERR_SPACE);
+
+			memcpy(out + total, tmp, w);
+		}
+
+		total  += w;
+		in     += n;
+		in_len -= n;
+	}
+
+	if((ret = basen_stream_final(&st, tmp, &w)) < 0)
+	        return(ret);
+	if(w > out_cap - total)
+	        return(BASEN_ERR_SPACE);
+
+	memcpy(out + total, tmp, w);
+	total += w;
+
+	if(written != NULL)
+	        *written = total;
+
+	return(0);
+}
+
+/** Decode a memory area of known size. This function decodes the first
+ *  \c in_len characters at \c in, which don't have to be null-terminated,
+ *  and stores the result at \c out. The result will \e not be
+ *  null-terminated. Both upper and lower case are accepted by base16 and
+ *  base32. \c flags may hold
+ *  - BASEN_URLSAFE: the URL and filename safe alphabet (base64),
+ *  - BASEN_NOPAD: accept input that lacks the padding (padded input is
+ *    still accepted), \c in_len need not be a multiple of the block size
+ *    then (base32, base64),
+ *  - BASEN_SKIPWS: ignore whitespace anywhere in the input, e.g. line
+ *    breaks.
+ *
+ *  Without BASEN_SKIPWS nothing is written if the result doesn't fit into
+ *  \c out_cap bytes; with it, \c out may have been partially written.
+ *
+ * @param codec BASEN_BASE16, BASEN_BASE32, BASEN_BASE32HEX or BASEN_BASE64
+ * @param out pointer to destination
+ * @param out_cap size of the destination in bytes
+ * @param in pointer to source
+ * @param in_len input size in characters
+ * @param written where to store the number of bytes decoded (may be NULL)
+ * @param flags decoding options
+ * @returns 0 on success, BASEN_ERR_INPUT on malformed input (\c out may
+ *          have been partially written) or BASEN_ERR_SPACE if \c out_cap
+ *          is too small
+ *
+ * @ingroup base64
+ */
+int basen_decode(int codec, unsigned char *out, size_t out_cap,
+		 const char *in, size_t in_len, size_t *written, int flags)
+{
+	const basen_codec *c = basen_codecs[codec];
+	int alpha = basen_alpha(codec, flags);
+	size_t n = in_len, full, rem, size;
+
+	if(flags & BASEN_SKIPWS)
+	        return(basen_decode_ws(codec, out, out_cap, in, in_len,
+				       written, flags));
+
+	while(n > 0 && in_len - n < (size_t)c->ochars - 1 && in[n - 1] == '=')
+	        --n;
+
+	if(in_len % c->ochars != 0 &&
+	   (n != in_len || (flags & BASEN_NOPAD) == 0))
+	        return(BASEN_ERR_INPUT);
+
+	full = n / c->ochars;
+	rem  = n % c->ochars;
+	size = full * c->ibytes + rem * c->bits / 8;
+
+	if(size > out_cap)
+	        return(BASEN_ERR_SPACE);
+
+	/* the short block is kept away from the block decoder, whose SIMD
+	 * kernels may store a few bytes beyond the block they decode */
+	if(c->decode(out, in, full, alpha) != full ||
+	   (rem > 0 && basen_decode_last(c, out + full * c->ibytes,
+					 in + full * c->ochars,
+					 (int)rem, alpha) < 0))
+	        return(BASEN_ERR_INPUT);
+
+	if(written != NULL)
+	        *written = size;
+
+	return(0);
+}
+
+/** Initialize an incremental encoder or decoder. The stream functions let
+ *  you encode or decode data that arrives in chunks of arbitrary size; the
+ *  bytes which don't make up a complete block are kept in \c st until the
+ *  next call. The state holds no resources, so there's nothing to free.
+ *
+ * @param st pointer to the state
+ * @param codec BASEN_BASE16, BASEN_BASE32, BASEN_BASE32HEX or BASEN_BASE64
+ * @param mode BASEN_ENCODE or BASEN_DECODE, optionally or'ed with the
+ *        options of basen_encode() or basen_decode()
+ * @returns nothing
+ *
+ * @ingroup base64
+ */
+void basen_stream_init(basen_stream *st, int codec, int mode)
+{
+	st->codec = codec;
+	st->mode  = mode;
+	st->len   = 0;
+	st->col   = 0;
+	st->done  = 0;
+}
+
+/** Compute size of needed storage for a stream update. This function
+ *  computes the maximum number of bytes basen_stream_update() writes when
+ *  passed \c len bytes of input. basen_stream_final() writes no more than
+ *  eight bytes, plus a line break with BASEN_WRAP.
+ *
+ * @param st pointer to the state
+ * @param len input size
+ * @returns output size
+ *
+ * @ingroup base64
+ */
+size_t basen_stream_bound(const basen_stream *st, size_t len)
+{
+	const basen_codec *c = basen_codecs[st->codec];
+	size_t size;
+
+	if(st->mode & BASEN_DECODE)
+	        return((st->len + len) / c->ochars * c->ibytes);
+
+	size = (st->len + len) / c->ibytes * c->ochars;
+
+	if(BASEN_WRAPS(c, st->mode))
+	        size += (st->col + size) / c->line * 2;
+
+	return(size);
+}
+
+/* complete the block carried over in st from in */
+static size_t basen_stream_fill(basen_stream *st, const unsigned char *in,
+				size_t len, int size)
+{
+	size_t n = 0;
+
+	while(st->len < size && n < len)
+	        st->buf[st->len++] = in[n++];
+
+	return(n);
+}
+
+/* start a new line if the current one is full */
+static char *basen_stream_wrap(basen_stream *st, const basen_codec *c,
+			       char *out)
+{
+	if(BASEN_WRAPS(c, st->mode) && st->col == c->line) {
+		*out++  = '\r';
+		*out++  = '\n';
+		st->col = 0;
+	}
+
+	return(out);
+}
+
+/* encode n complete blocks, breaking lines as needed */
+static char *basen_stream_put(basen_stream *st, const basen_codec *c,
+			      char *out, const unsigned char *in, size_t n)
+{
+	int alpha = basen_alpha(st->codec, st->mode);
+	size_t k;
+
+	if(!BASEN_WRAPS(c, st->mode)) {
+		c->encode(out, in, n, alpha);
+		return(out + n * c->ochars);
+	}
+
+	while(n > 0) {
+		out = basen_stream_wrap(st, c, out);
+
+		k = (size_t)(c->line - st->col) / c->ochars;
+		if(k > n)
+		        k = n;
+
+		c->encode(out, in, k, alpha);
+		out     += k * c->ochars;
+		in      += k * c->ibytes;
+		n       -= k;
+		st->col += (int)k * c->ochars;
+	}
+
+	return(out);
+}
+
+static int basen_stream_encode(basen_stream *st, char *out, size_t *written,
+			       const unsigned char *in, size_t len)
+{
+	const basen_codec *c = basen_codecs[st->codec];
+	char *start = out;
+	size_t n;
+
+	*written = 0;
+
+	if(st->len > 0) {
+		n    = basen_stream_fill(st, in, len, c->ibytes);
+		in  += n;
+		len -= n;
+
+		if(st->len < c->ibytes)
+		        return(0);
+
+		out     = basen_stream_put(st, c, out, st->buf, 1);
+		st->len = 0;
+	}
+
+	out = basen_stream_put(st, c, out, in, len / c->ibytes);
+	n   = len / c->ibytes * c->ibytes;
+
+	memcpy(st->buf, in + n, len - n);
+	st->len  = (int)(len - n);
+	*written = out - start;
+
+	return(0);
+}
+
+/* decode a run of input which contains no whitespace to skip */
+static int basen_stream_decode_run(basen_stream *st, unsigned char **out,
+				   const char *in, size_t len)
+{
+	const basen_codec *c = basen_codecs[st->codec];
+	int r, alpha = basen_alpha(st->codec, st->mode);
+	size_t n, full;
+
+	if(len == 0)
+	        return(0);
+
+	if(st->done)
+	        return(BASEN_ERR_INPUT);
+
+	if(st->len > 0) {
+		n    = basen_stream_fill(st, (const unsigned char *)in, len,
+					 c->ochars);
+		in  += n;
+		len -= n;
+
+		if(st->len < c->ochars)
+		        return(0);
+
+		if(c->decode(*out, (const char *)st->buf, 1, alpha) == 1) {
+			r = c->ibytes;
+		} else {
+			/* only the very last block may be padded */
+			if(len > 0 ||
+			   (r = basen_decode_padded(c, *out, (const char *)st->buf,
+						    alpha)) < 0)
+			        return(BASEN_ERR_INPUT);
+			st->done = 1;
+		}
+
+		*out   += r;
+		st->len = 0;
+	}
+
+	full  = len / c->ochars;
+	n     = c->decode(*out, in, full, alpha);
+	*out += n * c->ibytes;
+
+	if(n < full) {
+		if((n + 1) * c->ochars != len ||
+		   (r = basen_decode_padded(c, *out, in + n * c->ochars,
+					    alpha)) < 0)
+		        return(BASEN_ERR_INPUT);
+
+		*out    += r;
+		st->done = 1;
+	}
+
+	n = full * c->ochars;
+
+	memcpy(st->buf, in + n, len - n);
+	st->len = (int)(len - n);
+
+	return(0);
+}
+
+static int basen_stream_decode(basen_stream *st, unsigned char *out,
+			       size_t *written, const char *in, size_t len)
+{
+	unsigned char *start = out;
+	size_t n;
+	int ret = 0;
+
+	if(st->mode & BASEN_SKIPWS) {
+		while(ret == 0 && len > 0) {
+			n    = charclass_cspan(&charclass_space, in, len);
+			ret  = basen_stream_decode_run(st, &out, in, n);
+			n   += charclass_span(&charclass_space, in + n, len - n);
+			in  += n;
+			len -= n;
+		}
+	} else {
+		ret = basen_stream_decode_run(st, &out, in, len);
+	}
+
+	*written = out - start;
+
+	return(ret);
+}
+
+/** Feed a chunk of input to an incremental encoder or decoder. The output
+ *  is \e not null-terminated.
+ *
+ * @attention \c out must have room for basen_stream_bound() bytes.
+ *
+ * @param st pointer to the state
+ * @param out pointer to destination
+ * @param written where to store the number of bytes written to \c out
+ * @param in pointer to source
+ * @param len input size in bytes
+ * @returns 0 on success or BASEN_ERR_INPUT if the decoder found an illegal
+ *          character or data after the padding
+ *
+ * @ingroup base64
+ */
+int basen_stream_update(basen_stream *st, void *out, size_t *written,
+			const void *in, size_t len)
+{
+	if(st->mode & BASEN_DECODE)
+	        return(basen_stream_decode(st, (unsigned char *)out, written,
+					   (const char *)in, len));
+
+	return(basen_stream_encode(st, (char *)out, written,
+				   (const unsigned char *)in, len));
+}
+
+/** Finish an incremental encoder or decoder. The encoder writes the last,
+ *  short block, the decoder writes nothing, or the last bytes with
+ *  BASEN_NOPAD, and fails if the input ended in the middle of a block. The
+ *  state may be reused after calling basen_stream_init() again.
+ *
+ * @param st pointer to the state
+ * @param out pointer to destination
+ * @param written where to store the number of bytes written to \c out
+ * @returns 0 on success or BASEN_ERR_INPUT on truncated input
+ *
+ * @ingroup base64
+ */
+int basen_stream_final(basen_stream *st, void *out, size_t *written)
+{
+	const basen_codec *c = basen_codecs[st->codec];
+	int n, alpha = basen_alpha(st->codec, st->mode);
+	char *p = out;
+
+	*written = 0;
+
+	if(st->len == 0)
+	        return(0);
+
+	if(st->mode & BASEN_DECODE) {
+		if((st->mode & BASEN_NOPAD) == 0 || st->done ||
+		   (n = basen_decode_last(c, out, (const char *)st->buf,
+					  st->len, alpha)) < 0)
+		        return(BASEN_ERR_INPUT);
+	} else {
+		p = basen_stream_wrap(st, c, p);
+		n = (int)(p - (char *)out) +
+		    basen_encode_last(c, p, st->buf, st->len, alpha, st->mode);
+	}
+
+	*written = n;
+	st->len  = 0;
+
+	return(0);
+}
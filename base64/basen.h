@@ -0,0 +1,114 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Base16/Base32/Base64 block engine header.
+ * @ingroup base64
+ */
+
+#ifndef _BASEN_H
+#define _BASEN_H
+
+#define BASEN_ERR_INPUT (-1)
+#define BASEN_ERR_SPACE (-2)
+
+/* codecs */
+#define BASEN_BASE16    0    /* hex, RFC 4648 section 8 */
+#define BASEN_BASE32    1    /* RFC 4648 section 6 */
+#define BASEN_BASE32HEX 2    /* RFC 4648 section 7 */
+#define BASEN_BASE64    3    /* RFC 4648 section 4 and 5, see base64.h */
+
+#define BASEN_ENCODE    0x00
+#define BASEN_DECODE    0x01
+
+#define BASEN_URLSAFE   0x02  /* base64: '-' and '_' instead of '+' and '/' */
+#define BASEN_NOPAD     0x04  /* base32, base64: no (or optional) padding */
+#define BASEN_WRAP      0x08  /* base64: break lines with CRLF */
+#define BASEN_SKIPWS    0x10  /* skip whitespace when decoding */
+#define BASEN_UPPER     0x20  /* base16: encode with upper case digits */
+
+/** State of an incremental encoder or decoder, see basen_stream_init().
+ * @ingroup base64
+ */
+typedef struct {
+	int           codec;
+	int           mode;     /* BASEN_ENCODE or BASEN_DECODE and options */
+	int           len;      /* number of bytes in buf */
+	int           col;      /* encoder's position in the current line */
+	int           done;     /* decoder has seen the padding */
+	unsigned char buf[8];   /* incomplete block carried over */
+} basen_stream;
+
+/** A codec as seen by the engine. The block functions convert \c n complete
+ *  blocks; the decoder stops at the first block holding a character outside
+ *  the alphabet and returns the number of blocks decoded. The functions for
+ *  the last block get a short block of \c len bytes or characters (without
+ *  padding) and return the number of characters or bytes written, or -1.
+ *  Codecs whose blocks are a single byte have no short blocks and leave
+ *  them NULL. \c alpha selects the alphabet: 1 for upper case base16,
+ *  base32hex and URL safe base64, otherwise 0.
+ * @ingroup base64
+ */
+typedef struct {
+	int ibytes;   /* bytes per block */
+	int ochars;   /* characters per block */
+	int bits;     /* bits per character */
+	int line;     /* line length for BASEN_WRAP (a multiple of ochars), or
+		       * 0 if the codec isn't wrapped */
+	size_t (*encode)(char *out, const unsigned char *in, size_t n, int alpha);
+	size_t (*decode)(unsigned char *out, const char *in, size_t n, int alpha);
+	int    (*encode_last)(char *out, const unsigned char *in, int len, int alpha);
+	int    (*decode_last)(unsigned char *out, const char *in, int len, int alpha);
+} basen_codec;
+
+/* defined in base64.c */
+extern const basen_codec base64_codec;
+
+/* Helpers for building wide lookup tables with the preprocessor: apply the
+ * macro f to 4, 16, ... consecutive values starting at i. */
+#define BN_R4(f, i)    f(i), f((i) + 1), f((i) + 2), f((i) + 3)
+#define BN_R16(f, i)   BN_R4(f, i), BN_R4(f, (i) + 4), \
+		       BN_R4(f, (i) + 8), BN_R4(f, (i) + 12)
+#define BN_R64(f, i)   BN_R16(f, i), BN_R16(f, (i) + 16), \
+		       BN_R16(f, (i) + 32), BN_R16(f, (i) + 48)
+#define BN_R256(f, i)  BN_R64(f, i), BN_R64(f, (i) + 64), \
+		       BN_R64(f, (i) + 128), BN_R64(f, (i) + 192)
+#define BN_R1024(f, i) BN_R256(f, i), BN_R256(f, (i) + 256), \
+		       BN_R256(f, (i) + 512), BN_R256(f, (i) + 768)
+#define BN_R4096(f, i) BN_R1024(f, i), BN_R1024(f, (i) + 1024), \
+		       BN_R1024(f, (i) + 2048), BN_R1024(f, (i) + 3072)
+
+size_t basen_encoded_size(int codec, size_t len, int flags);
+size_t basen_decoded_size(int codec, size_t len);
+size_t basen_encode(int codec, char *out, const unsigned char *in, size_t len, int flags);
+int    basen_decode(int codec, unsigned char *out, size_t out_cap, const char *in, size_t in_len, size_t *written, int flags);
+
+void   basen_stream_init(basen_stream *st, int codec, int mode);
+size_t basen_stream_bound(const basen_stream *st, size_t len);
+int    basen_stream_update(basen_stream *st, void *out, size_t *written, const void *in, size_t len);
+int    basen_stream_final(basen_stream *st, void *out, size_t *written);
+
+#endif /* ! _BASEN_H */
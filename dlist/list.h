@@ -42,14 +42,19 @@ typedef struct testdata_ {
 	char str[1024];
 } testdata;
 
+struct arena_;
+
 node_l *list_alloc_node(void *);
 void    list_free_node(node_l *);
+node_l *list_alloc_node_a(struct arena_ *, void *);
 node_l *list_get_first_node(node_l **);
 node_l *list_get_last_node(node_l **);
 void   *list_get_first(node_l **);
 void   *list_get_last(node_l **);
 int     list_prepend(node_l **, void *);
 int     list_append(node_l **, void *);
+int     list_prepend_a(struct arena_ *, node_l **, void *);
+int     list_append_a(struct arena_ *, node_l **, void *);
 void    list_prepend_node(node_l **, node_l *);
 void    list_append_node(node_l **, node_l *);
 void    list_join(node_l **, node_l **);
@@ -0,0 +1,78 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Arena-backed list functions, apart from list.c so that it builds without
+ * arena/. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "list.h"
+#include "arena.h"
+
+
+/* Nodes allocated from an arena are released with the arena; they must not
+ * be passed to list_free_node(). */
+node_l *list_alloc_node_a(arena *a, void *data)
+{
+	node_l *n = NULL;
+
+	assert(a != NULL);
+
+	if((n = arena_alloc(a, sizeof(node_l))) != NULL) {
+		n->data = data;
+	}
+
+	return(n);
+}
+
+
+int list_prepend_a(arena   *a,
+                   node_l **list,
+                   void    *data)
+{
+	node_l *n = NULL;
+
+	if((n = list_alloc_node_a(a, data)) == NULL) {
+		return(-1);
+	} else {
+		list_prepend_node(list, n);
+		return(0);
+	}
+}
+
+
+int list_append_a(arena   *a,
+                  node_l **list,
+                  void    *data)
+{
+	if(list_prepend_a(a, list, data) < 0) {
+		return(-1);
+	} else {
+		*list = (*list)->next;
+		return(0);
+	}
+}
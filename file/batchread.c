@@ -0,0 +1,591 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Reading the same part of many files at once, e.g. the tags of a music
+ * library. With one open/seek/read/close per file the system call overhead
+ * and the latency of every single read add up, so the reads are batched:
+ *
+ * On Linux, io_uring (set up with raw system calls) keeps up to
+ * BATCH_READ_DEPTH files in flight. Every file goes through openat, statx
+ * (only to find the offset when reading from the end), read and close; the
+ * completion of one step queues the next, and all queued steps are
+ * submitted with a single io_uring_enter() that also waits for the next
+ * completions. Kernels without io_uring or without these operations (and
+ * other systems) get the same interface on BATCH_READ_THREADS threads doing
+ * plain pread(). Either way the callback runs for one file at a time.
+ *
+ * Should io_uring_enter() fail for good, the entries it didn't take are
+ * taken back and the ring is drained: buffers and descriptors are only
+ * given up once the kernel is done with every request in flight. */
+
+#define _GNU_SOURCE  /* statx, MAP_POPULATE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "batchread.h"
+#include "pool.h"
+
+#if defined(__linux__) && defined(__GNUC__)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(STATX_SIZE)
+#define BATCH_READ_URING 1
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+typedef struct {
+	const char *const *paths;
+	size_t npaths;
+	long offset;
+	size_t len;
+	batch_read_func *func;
+	void *arg;
+	pthread_mutex_t lock;
+	int stop;              /* first nonzero callback result */
+	int error;
+} batch_job;
+
+/* where to read a file of the given size */
+static off_t batch_offset(const batch_job *j, off_t size)
+{
+	if(j->offset >= 0)
+		return(j->offset);
+
+	return(size > -j->offset ? size + j->offset : 0);
+}
+
+/* pass the data of file i to the callback unless stopped; len < 0 is
+ * -errno */
+static void batch_deliver(batch_job *j, size_t i, const char *data, long len)
+{
+	int r;
+
+	if(j->stop == 0 && (r = j->func(j->arg, i, data, len)) != 0)
+		j->stop = r;
+}
+
+static void batch_thread_file(void *arg, size_t i)
+{
+	batch_job *j = arg;
+	struct stat st;
+	size_t got = 0;
+	char *buf;
+	off_t off = 0;
+	ssize_t n = 0;
+	int fd;
+
+	pthread_mutex_lock(&j->lock);
+	n = j->stop;
+	pthread_mutex_unlock(&j->lock);
+
+	if(n != 0)
+		return;
+
+	if((buf = malloc(j->len)) == NULL) {
+		n = -ENOMEM;
+		goto out;
+	}
+
+	if((fd = open(j->paths[i], O_RDONLY)) < 0) {
+		n = -errno;
+		goto out;
+	}
+
+	if(j->offset < 0 && fstat(fd, &st) < 0)
+		n = -errno;
+	else
+		off = batch_offset(j, j->offset < 0 ? st.st_size : 0);
+
+	while(n == 0 && got < j->len) {
+		if((n = pread(fd, buf + got, j->len - got, off + got)) > 0) {
+			got += n;
+			n    = 0;
+		} else if(n < 0 && errno == EINTR) {
+			n = 0;
+		} else if(n < 0) {
+			n = -errno;
+		} else {
+			break;
+		}
+	}
+
+	close(fd);
+out:
+	pthread_mutex_lock(&j->lock);
+	batch_deliver(j, i, buf, n < 0 ? (long)n : (long)got);
+	pthread_mutex_unlock(&j->lock);
+
+	free(buf);
+}
+
+static void batch_threads(batch_job *j)
+{
+	if(pthread_mutex_init(&j->lock, NULL) != 0) {
+		j->error = 1;
+		return;
+	}
+
+	if(pool_run(j->npaths, BATCH_READ_THREADS, batch_thread_file, j) < 0)
+		j->error = 1;
+
+	pthread_mutex_destroy(&j->lock);
+}
+
+#ifdef BATCH_READ_URING
+
+enum { BR_OPEN, BR_STAT, BR_READ, BR_CLOSE };
+
+typedef struct {
+	size_t index;          /* file being read */
+	int state;
+	int fd;
+	long err;
+	off_t off;
+	size_t got;
+	char *buf;
+	struct statx stx;
+} br_slot;
+
+typedef struct {
+	int fd;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_len;
+	size_t cq_len;
+	size_t sqe_len;
+	unsigned pending;      /* entries queued since the last submission */
+} br_ring;
+
+static void br_ring_free(br_ring *r)
+{
+	if(r->sqes != NULL)
+		munmap(r->sqes, r->sqe_len);
+	if(r->cq_ptr != NULL && r->cq_ptr != r->sq_ptr)
+		munmap(r->cq_ptr, r->cq_len);
+	if(r->sq_ptr != NULL)
+		munmap(r->sq_ptr, r->sq_len);
+
+	close(r->fd);
+}
+
+/* nonzero if the kernel has all the operations needed */
+static int br_probe(int fd)
+{
+	static const int ops[] = {
+		IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+		IORING_OP_CLOSE
+	};
+	struct io_uring_probe *p;
+	size_t i, size;
+	int ok = 0;
+
+	size = sizeof(*p) + 256 * sizeof(p->ops[0]);
+	if((p = calloc(1, size)) == NULL)
+		return(0);
+
+	if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, p,
+		   256) == 0) {
+		for(i = 0, ok = 1; i < sizeof(ops) / sizeof(ops[0]); i++)
+			if(ops[i] > p->last_op ||
+			   !(p->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+				ok = 0;
+	}
+
+	free(p);
+
+	return(ok);
+}
+
+static int br_ring_init(br_ring *r, unsigned entries)
+{
+	struct io_uring_params p;
+	char *sq, *cq;
+
+	memset(r, 0, sizeof(*r));
+	memset(&p, 0, sizeof(p));
+
+	if((r->fd = (int)syscall(__NR_io_uring_setup, entries, &p)) < 0)
+		return(-1);
+
+	if(!br_probe(r->fd)) {
+		close(r->fd);
+		return(-1);
+	}
+
+	r->sq_len  = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_len  = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqe_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	if((p.features & IORING_FEAT_SINGLE_MMAP) && r->cq_len > r->sq_len)
+		r->sq_len = r->cq_len;
+
+	r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if(r->sq_ptr == MAP_FAILED) {
+		r->sq_ptr = NULL;
+		br_ring_free(r);
+		return(-1);
+	}
+
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ptr = r->sq_ptr;
+	} else {
+		r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE, r->fd,
+				 IORING_OFF_CQ_RING);
+		if(r->cq_ptr == MAP_FAILED) {
+			r->cq_ptr = NULL;
+			br_ring_free(r);
+			return(-1);
+		}
+	}
+
+	r->sqes = mmap(NULL, r->sqe_len, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if(r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		br_ring_free(r);
+		return(-1);
+	}
+
+	sq = r->sq_ptr;
+	cq = r->cq_ptr;
+
+	r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_array = (unsigned *)(sq + p.sq_off.array);
+	r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	return(0);
+}
+
+/* queue an entry for slot s; every slot has at most one in flight, so the
+ * ring (as large as the number of slots) can't overflow */
+static struct io_uring_sqe *br_queue(br_ring *r, br_slot *slots, br_slot *s,
+				     int op, int state)
+{
+	unsigned tail = *r->sq_tail, i = tail & *r->sq_mask;
+	struct io_uring_sqe *e = &r->sqes[i];
+
+	memset(e, 0, sizeof(*e));
+	e->opcode    = op;
+	e->user_data = s - slots;
+	s->state     = state;
+
+	r->sq_array[i] = i;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	r->pending++;
+
+	return(e);
+}
+
+static void br_open(br_ring *r, br_slot *slots, br_slot *s,
+		    const batch_job *j, size_t i)
+{
+	struct io_uring_sqe *e = br_queue(r, slots, s, IORING_OP_OPENAT,
+					  BR_OPEN);
+
+	s->index = i;
+	s->fd    = -1;
+	s->got   = 0;
+
+	e->fd         = AT_FDCWD;
+	e->addr       = (uintptr_t)j->paths[i];
+	e->open_flags = O_RDONLY;
+}
+
+static void br_read(br_ring *r, br_slot *slots, br_slot *s, const batch_job *j)
+{
+	struct io_uring_sqe *e = br_queue(r, slots, s, IORING_OP_READ,
+					  BR_READ);
+	size_t len = j->len - s->got;
+
+	/* the rest is read by further requests */
+	if(len > UINT_MAX)
+		len = UINT_MAX;
+
+	e->fd   = s->fd;
+	e->addr = (uintptr_t)(s->buf + s->got);
+	e->len  = (unsigned)len;
+	e->off  = s->off + s->got;
+}
+
+static void br_stat(br_ring *r, br_slot *slots, br_slot *s)
+{
+	struct io_uring_sqe *e = br_queue(r, slots, s, IORING_OP_STATX,
+					  BR_STAT);
+
+	e->fd          = s->fd;
+	e->addr        = (uintptr_t)"";
+	e->len         = STATX_SIZE;
+	e->off         = (uintptr_t)&s->stx;
+	e->statx_flags = AT_EMPTY_PATH;
+}
+
+static void br_close(br_ring *r, br_slot *slots, br_slot *s)
+{
+	br_queue(r, slots, s, IORING_OP_CLOSE, BR_CLOSE)->fd = s->fd;
+}
+
+/* advance slot s by the completion of its last step; returns 1 when the
+ * slot is done with its file */
+static int br_step(br_ring *r, br_slot *slots, br_slot *s, batch_job *j,
+		   int res)
+{
+	switch(s->state) {
+	case BR_OPEN:
+		if(res < 0) {
+			batch_deliver(j, s->index, NULL, res);
+			return(1);
+		}
+
+		s->fd = res;
+
+		if(j->stop)
+			br_close(r, slots, s);
+		else if(j->offset < 0)
+			br_stat(r, slots, s);
+		else {
+			s->off = j->offset;
+			br_read(r, slots, s, j);
+		}
+		return(0);
+
+	case BR_STAT:
+		if(res < 0) {
+			batch_deliver(j, s->index, NULL, res);
+		} else {
+			s->off = batch_offset(j, (off_t)s->stx.stx_size);
+			br_read(r, slots, s, j);
+			return(0);
+		}
+		break;
+
+	case BR_READ:
+		if(res > 0 && (s->got += res) < j->len) {
+			br_read(r, slots, s, j);
+			return(0);
+		}
+
+		batch_deliver(j, s->index, s->buf, res < 0 ? res : (long)s->got);
+		break;
+
+	default:
+		return(1);
+	}
+
+	br_close(r, slots, s);
+
+	return(0);
+}
+
+/* take back the queued entries the kernel didn't take, closing the files
+ * of their slots; returns their number */
+static size_t br_unqueue(br_ring *r, br_slot *slots)
+{
+	unsigned tail = *r->sq_tail, k;
+	size_t n = r->pending;
+	br_slot *s;
+
+	for(k = tail - r->pending; k != tail; k++) {
+		s = &slots[r->sqes[r->sq_array[k & *r->sq_mask]].user_data];
+		if(s->state != BR_OPEN)
+			close(s->fd);
+	}
+
+	__atomic_store_n(r->sq_tail, tail - r->pending, __ATOMIC_RELEASE);
+	r->pending = 0;
+
+	return(n);
+}
+
+/* finish slot s after the completion of its last step without going on */
+static void br_abort(br_slot *s, int res)
+{
+	switch(s->state) {
+	case BR_OPEN:
+		if(res >= 0)
+			close(res);
+		break;
+
+	case BR_STAT:
+	case BR_READ:
+		close(s->fd);
+		break;
+	}
+}
+
+/* returns -1 if io_uring can't be used */
+static int batch_uring(batch_job *j)
+{
+	struct timespec ts = { 0, 1000000L };
+	size_t nslots, next = 0, busy = 0, i;
+	unsigned head, tail;
+	br_slot *slots;
+	char *bufs = NULL;
+	br_ring r;
+	int n, failed = 0;
+
+	nslots = j->npaths < BATCH_READ_DEPTH ? j->npaths : BATCH_READ_DEPTH;
+
+	if(br_ring_init(&r, (unsigned)nslots) < 0)
+		return(-1);
+
+	j->error = 1;
+
+	slots = calloc(nslots, sizeof(*slots));
+	if(j->len <= (size_t)-1 / nslots)
+		bufs = malloc(nslots * j->len);
+
+	if(slots == NULL || bufs == NULL)
+		goto out;
+
+	for(i = 0; i < nslots; i++) {
+		slots[i].buf = bufs + i * j->len;
+		br_open(&r, slots, &slots[i], j, next++);
+		busy++;
+	}
+
+	while(busy > 0) {
+		n = (int)syscall(__NR_io_uring_enter, r.fd, r.pending, 1,
+				 IORING_ENTER_GETEVENTS, NULL, 0);
+
+		/* reaping completions makes room for another try */
+		if(n < 0 && (errno == EINTR || errno == EAGAIN ||
+			     errno == EBUSY)) {
+			n = 0;
+		} else if(n < 0 && !failed) {
+			busy  -= br_unqueue(&r, slots);
+			failed = 1;
+			n      = 0;
+		} else if(n < 0) {
+			/* can't wait in the kernel; look again shortly */
+			nanosleep(&ts, NULL);
+			n = 0;
+		}
+
+		r.pending -= n;
+
+		head = *r.cq_head;
+		tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+
+		for(; head != tail; head++) {
+			struct io_uring_cqe *c = &r.cqes[head & *r.cq_mask];
+			br_slot *s = &slots[c->user_data];
+
+			if(failed) {
+				br_abort(s, c->res);
+				busy--;
+				continue;
+			}
+
+			if(!br_step(&r, slots, s, j, c->res))
+				continue;
+
+			if(next < j->npaths && j->stop == 0)
+				br_open(&r, slots, s, j, next++);
+			else
+				busy--;
+		}
+
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	j->error = failed;
+out:
+	free(slots);
+	free(bufs);
+	br_ring_free(&r);
+
+	return(0);
+}
+
+#endif  /* BATCH_READ_URING */
+
+/* read len bytes at offset (counted from the end of the file if negative)
+ * from each of the npaths files in paths and call func(arg, i, data, n)
+ * for every file i, with n the number of bytes read (fewer than len at the
+ * end of the file) or -errno if the file couldn't be read. data is only
+ * valid during the call. The files are read in parallel and func is called
+ * in any order, but never concurrently. A nonzero return value of func
+ * stops the batch and is returned. BATCH_READ_NOURING avoids io_uring.
+ * Returns 0 or -1 on error. */
+int batch_read(const char *const *paths, size_t npaths, long offset,
+	       size_t len, batch_read_func *func, void *arg, int flags)
+{
+	batch_job j;
+	int ret = -1;
+
+	assert(paths != NULL || npaths == 0);
+	assert(func  != NULL);
+	assert(len > 0);
+
+	if(npaths == 0)
+		return(0);
+
+	j.paths  = paths;
+	j.npaths = npaths;
+	j.offset = offset;
+	j.len    = len;
+	j.func   = func;
+	j.arg    = arg;
+	j.stop   = 0;
+	j.error  = 0;
+
+#ifdef BATCH_READ_URING
+	if((flags & BATCH_READ_NOURING) == 0)
+		ret = batch_uring(&j);
+#else
+	(void)flags;
+#endif
+
+	if(ret < 0)
+		batch_threads(&j);
+
+	return(j.error ? -1 : j.stop);
+}
@@ -30,22 +30,29 @@
 #include <string.h>
 #include "file.h"
 
-/* UNIX file ending. Might yield funny results on Windows/Mac files. */
+/* UNIX file ending. Might yield funny results on Windows/Mac files; a
+ * line_reader with LINE_READER_CRLF handles those. The line is read into a
+ * buffer that doubles in size as needed; null characters in the line are
+ * kept like any other. */
 char *file_read_line(FILE *fp)
 {
-	char *ret = NULL;
+	char *ret = NULL, *tmp;
+	size_t i = 0, size = 0;
 	int c;
-	size_t i = 0;
 
 	assert(fp != NULL);
 
-	while((c = fgetc(fp)) != EOF) {
-		i++;
-		ret = realloc(ret, i + 1);
-		if(ret == NULL)
-			return(NULL);
+	while((c = getc(fp)) != EOF) {
+		if(i + 2 > size) {
+			size = size ? size * 2 : 128;
+			if((tmp = realloc(ret, size)) == NULL) {
+				free(ret);
+				return(NULL);
+			}
+			ret = tmp;
+		}
 
-		ret[i - 1] = c;
+		ret[i++] = c;
 
 		if(c == '\n') break;
 	}
@@ -56,29 +63,31 @@ char *file_read_line(FILE *fp)
 	return(ret);
 }
 
-
 char **file_read(FILE *fp)
 {
-	char **ret = NULL;
+	char **ret = NULL, **tmp;
 	char *line;
-	size_t i = 0;
+	size_t i = 0, size = 0;
 
 	assert(fp != NULL);
 
-	while((line = file_read_line(fp)) != NULL) {
-		i++;
-		ret = realloc(ret, sizeof(*ret) * i);
-		if(ret == NULL)
-			return(NULL);
-
-		ret[i - 1] = line;
-	}
-
-	ret = realloc(ret, sizeof(*ret) * (i + 1));
-	if(ret == NULL)
-		return(NULL);
-
-	ret[i] = NULL;
+	do {
+		line = file_read_line(fp);
+
+		if(i == size) {
+			size = size ? size * 2 : 64;
+			if((tmp = realloc(ret, sizeof(*ret) * size)) == NULL) {
+				while(i > 0)
+					free(ret[--i]);
+				free(ret);
+				free(line);
+				return(NULL);
+			}
+			ret = tmp;
+		}
+
+		ret[i++] = line;
+	} while(line != NULL);
 
 	return(ret);
 }
@@ -26,7 +26,10 @@
 #ifndef FILE_H_
 #define FILE_H_
 
+struct arena_;
+
 char *file_read_line(FILE *fp);
+char *file_read_line_a(struct arena_ *a, FILE *fp);
 char **file_read(FILE *fp);
 
 #endif  /* ! FILE_H_ */
@@ -0,0 +1,64 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Arena-backed variant of file_read_line(), apart from file.c so that it
+ * builds without arena/. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "file.h"
+#include "arena.h"
+
+/* same as file_read_line(), but the line is allocated from arena a */
+char *file_read_line_a(arena *a, FILE *fp)
+{
+	char *ret = NULL, *tmp;
+	size_t i = 0, size = 0;
+	int c;
+
+	assert(a  != NULL);
+	assert(fp != NULL);
+
+	while((c = getc(fp)) != EOF) {
+		if(i + 2 > size) {
+			tmp = arena_realloc(a, ret, size, size ? size * 2 : 128);
+			if(tmp == NULL)
+				return(NULL);
+
+			ret  = tmp;
+			size = size ? size * 2 : 128;
+		}
+
+		ret[i++] = c;
+
+		if(c == '\n') break;
+	}
+
+	if(i)
+		ret[i] = '\0';
+
+	return(ret);
+}
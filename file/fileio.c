@@ -0,0 +1,93 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Block I/O adapters for code that works on both FILE streams and file
+ * descriptors. All of them share one signature, so a caller can store one
+ * of them in a function pointer together with its context: the FILE * for
+ * file_read_block() and file_write_block(), a pointer to the descriptor
+ * for the _fd variants. */
+
+#define _POSIX_C_SOURCE 200112L  /* read(), write() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include "fileio.h"
+
+/* read up to len bytes from the stream ctx; returns their number, 0 at the
+ * end of the stream or -1 on error */
+long file_read_block(void *ctx, void *buf, size_t len)
+{
+	size_t n = fread(buf, 1, len, (FILE *)ctx);
+
+	if(n == 0 && ferror((FILE *)ctx))
+		return(-1);
+
+	return((long)n);
+}
+
+/* write all len bytes to the stream ctx; returns -1 on error or 0 */
+int file_write_block(void *ctx, const void *buf, size_t len)
+{
+	if(len > 0 && fwrite(buf, 1, len, (FILE *)ctx) != len)
+		return(-1);
+
+	return(0);
+}
+
+/* same as file_read_block(), but ctx points to a file descriptor; reads
+ * interrupted by a signal are restarted */
+long file_read_block_fd(void *ctx, void *buf, size_t len)
+{
+	ssize_t n;
+
+	do {
+		n = read(*(int *)ctx, buf, len);
+	} while(n < 0 && errno == EINTR);
+
+	return((long)n);
+}
+
+/* same as file_write_block(), but ctx points to a file descriptor; short
+ * writes are continued */
+int file_write_block_fd(void *ctx, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while(len > 0) {
+		if((n = write(*(int *)ctx, p, len)) < 0) {
+			if(errno == EINTR)
+				continue;
+			return(-1);
+		}
+
+		p   += n;
+		len -= n;
+	}
+
+	return(0);
+}
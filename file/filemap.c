@@ -0,0 +1,235 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Memory-mapped file access. The whole file is mapped read-only and the
+ * start of every line is recorded in one pass over the data, after which
+ * lines are available by number as views into the mapping: nothing is
+ * copied and nothing is null-terminated. Input that can't be mapped, such
+ * as pipes, is read into a buffer instead, with the same result. */
+
+#define _POSIX_C_SOURCE 200112L  /* read(), posix_madvise() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "filemap.h"
+
+#define FILE_MAP_BLOCK_SIZE 65536
+
+/* initial size of a line index */
+#define FILE_MAP_INDEX_MIN  1024
+
+/* read all of fd into a malloc()ed buffer */
+static int file_map_read(file_map *m, int fd)
+{
+	size_t size = FILE_MAP_BLOCK_SIZE;
+	char *tmp;
+	ssize_t n;
+
+	if((m->data = malloc(size)) == NULL)
+		return(-1);
+
+	for(;;) {
+		if(m->size == size) {
+			if((tmp = realloc(m->data, size * 2)) == NULL)
+				return(-1);
+
+			m->data = tmp;
+			size   *= 2;
+		}
+
+		n = read(fd, m->data + m->size, size - m->size);
+
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n < 0)
+			return(-1);
+		if(n == 0)
+			return(0);
+
+		m->size += n;
+	}
+}
+
+/* record the start of every line in data[begin, end) as an offset from
+ * data, followed by end, in a malloc()ed array. The number of lines is
+ * stored in nlines. The array starts small and doubles, so a file with
+ * long lines costs little, and is cut to size at the end. Returns NULL if
+ * out of memory. */
+size_t *file_map_index_lines(const char *data, size_t begin, size_t end,
+			     size_t *nlines)
+{
+	const char *p = data + begin, *e = data + end, *nl;
+	size_t n = 0, size = FILE_MAP_INDEX_MIN, *lines, *tmp;
+
+	assert(data != NULL || begin == end);
+	assert(nlines != NULL);
+
+	if((lines = malloc(sizeof(*lines) * size)) == NULL)
+		return(NULL);
+
+	while(p < e) {
+		if(n + 1 == size) {
+			tmp = realloc(lines, sizeof(*lines) * size * 2);
+			if(tmp == NULL) {
+				free(lines);
+				return(NULL);
+			}
+
+			lines = tmp;
+			size *= 2;
+		}
+
+		lines[n++] = p - data;
+
+		if((nl = memchr(p, '\n', e - p)) == NULL)
+			break;
+
+		p = nl + 1;
+	}
+
+	lines[n] = end;
+
+	if((tmp = realloc(lines, sizeof(*lines) * (n + 1))) != NULL)
+		lines = tmp;
+
+	*nlines = n;
+
+	return(lines);
+}
+
+static int file_map_index(file_map *m)
+{
+	m->lines = file_map_index_lines(m->data, 0, m->size, &m->nlines);
+
+	return(m->lines == NULL ? -1 : 0);
+}
+
+/* map the file open on fd, which may be closed afterwards. Descriptors
+ * that can't be mapped are read up to the end of file. */
+file_map *file_map_fd(int fd)
+{
+	struct stat st;
+	file_map *m;
+	void *p;
+
+	if((m = malloc(sizeof(*m))) == NULL)
+		return(NULL);
+
+	m->data   = NULL;
+	m->size   = 0;
+	m->mapped = 0;
+	m->lines  = NULL;
+	m->nlines = 0;
+
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	   (off_t)(size_t)st.st_size == st.st_size) {
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p != MAP_FAILED) {
+			m->data   = p;
+			m->size   = st.st_size;
+			m->mapped = 1;
+
+			/* the index is built front to back */
+			posix_madvise(p, m->size, POSIX_MADV_SEQUENTIAL);
+		}
+	}
+
+	if((!m->mapped && file_map_read(m, fd) < 0) || file_map_index(m) < 0) {
+		file_map_destroy(m);
+		return(NULL);
+	}
+
+	if(m->mapped)
+		posix_madvise(m->data, m->size, POSIX_MADV_NORMAL);
+
+	return(m);
+}
+
+/* map the file at path */
+file_map *file_map_open(const char *path)
+{
+	file_map *m;
+	int fd;
+
+	assert(path != NULL);
+
+	do {
+		fd = open(path, O_RDONLY);
+	} while(fd < 0 && errno == EINTR);
+
+	if(fd < 0)
+		return(NULL);
+
+	m = file_map_fd(fd);
+	close(fd);
+
+	return(m);
+}
+
+void file_map_destroy(file_map *m)
+{
+	if(m == NULL)
+		return;
+
+	if(m->mapped)
+		munmap(m->data, m->size);
+	else
+		free(m->data);
+
+	free(m->lines);
+	free(m);
+}
+
+/* returns the number of lines; a last line without newline counts, too */
+size_t file_map_lines(const file_map *m)
+{
+	assert(m != NULL);
+
+	return(m->nlines);
+}
+
+/* returns line i (counting from 0) and stores its length, including the
+ * newline, in len (if not NULL). The line is not null-terminated and
+ * must not be modified. Returns NULL if there is no such line. */
+const char *file_map_line(const file_map *m, size_t i, size_t *len)
+{
+	assert(m != NULL);
+
+	if(i >= m->nlines)
+		return(NULL);
+
+	if(len != NULL)
+		*len = m->lines[i + 1] - m->lines[i];
+
+	return(m->data + m->lines[i]);
+}
@@ -0,0 +1,378 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Parallel line processing for very large files. The file is mapped and
+ * cut into byte ranges, several per thread; every range is moved forward to
+ * the start of a line, so no line is split between two of them.
+ *
+ * Unordered delivery counts the lines of all ranges in parallel first, which
+ * gives every range the number of its first line, and then calls back for
+ * every range in parallel. Ordered delivery indexes the ranges in parallel
+ * and hands them to the callback strictly in file order: whichever thread
+ * finishes the range that is due delivers it, and any ranges behind it that
+ * are ready, while the other threads keep indexing. A thread doesn't start
+ * on a range more than one per thread ahead of the one that is due, which
+ * bounds the memory held by indexes waiting for delivery when the callback
+ * is slower than indexing. */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "filepar.h"
+#include "filemap.h"
+#include "linereader.h"
+#include "pool.h"
+
+/* ranges per thread, which evens out threads finishing at different times */
+#define FILE_PAR_SPLIT 4
+
+/* lines between two looks at the stop flag */
+#define FILE_PAR_POLL  4096
+
+typedef struct {
+	size_t begin;      /* the range is [begin, end) */
+	size_t end;
+	size_t lineno;     /* number of its first line */
+	size_t nlines;
+	size_t *lines;     /* line offsets (ordered delivery only) */
+	int ready;
+} par_range;
+
+typedef struct {
+	const char *data;
+	size_t size;
+	par_range *ranges;
+	size_t nranges;
+	file_line_func *func;
+	void *arg;
+	pthread_mutex_t lock;
+	pthread_cond_t moved;  /* next advanced or the job stopped */
+	size_t window;     /* ranges indexed ahead of next at most */
+	size_t next;       /* next range to deliver (ordered delivery) */
+	size_t lineno;     /* number of the next line to deliver */
+	int busy;          /* some thread is delivering */
+	int stop;          /* first nonzero callback result */
+	int error;
+} par_job;
+
+static int par_stopped(par_job *j)
+{
+	int r;
+
+	pthread_mutex_lock(&j->lock);
+	r = j->stop || j->error;
+	pthread_mutex_unlock(&j->lock);
+
+	return(r);
+}
+
+static void par_set_stop(par_job *j, int r)
+{
+	pthread_mutex_lock(&j->lock);
+	if(r < 0)
+		j->error = 1;
+	else if(j->stop == 0)
+		j->stop = r;
+	pthread_cond_broadcast(&j->moved);
+	pthread_mutex_unlock(&j->lock);
+}
+
+static void par_count_range(void *arg, size_t i)
+{
+	par_job *j = arg;
+	par_range *r = &j->ranges[i];
+	const char *p = j->data + r->begin, *end = j->data + r->end;
+	size_t n = 0;
+
+	while(p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+		++p;
+		++n;
+	}
+
+	/* a last line without newline */
+	if(r->end == j->size && r->end > r->begin && j->data[r->end - 1] != '\n')
+		++n;
+
+	r->nlines = n;
+}
+
+static void par_deliver_range(void *arg, size_t i)
+{
+	par_job *j = arg;
+	par_range *r = &j->ranges[i];
+	const char *p = j->data + r->begin, *end = j->data + r->end, *nl;
+	size_t lineno = r->lineno;
+	int ret;
+
+	while(p < end) {
+		if((lineno - r->lineno) % FILE_PAR_POLL == 0 && par_stopped(j))
+			return;
+
+		if((nl = memchr(p, '\n', end - p)) == NULL)
+			nl = end - 1;
+
+		if((ret = j->func(j->arg, lineno++, p, nl + 1 - p)) != 0) {
+			par_set_stop(j, ret);
+			return;
+		}
+
+		p = nl + 1;
+	}
+}
+
+/* hand an indexed range to the callback */
+static void par_deliver_index(par_job *j, par_range *r)
+{
+	size_t k;
+	int ret;
+
+	if(par_stopped(j))
+		return;
+
+	if(r->lines == NULL) {
+		par_set_stop(j, -1);
+		return;
+	}
+
+	for(k = 0; k < r->nlines; k++) {
+		ret = j->func(j->arg, j->lineno++, j->data + r->lines[k],
+			      r->lines[k + 1] - r->lines[k]);
+		if(ret != 0) {
+			par_set_stop(j, ret);
+			return;
+		}
+	}
+}
+
+static void par_ordered_range(void *arg, size_t i)
+{
+	par_job *j = arg;
+	par_range *r = &j->ranges[i];
+	int stopped;
+
+	/* ranges are handed out in order, so the one that is due has been
+	 * taken by a thread that isn't waiting here */
+	pthread_mutex_lock(&j->lock);
+	while(i - j->next > j->window && !j->stop && !j->error)
+		pthread_cond_wait(&j->moved, &j->lock);
+	stopped = j->stop || j->error;
+	pthread_mutex_unlock(&j->lock);
+
+	if(!stopped)
+		r->lines = file_map_index_lines(j->data, r->begin, r->end,
+						&r->nlines);
+
+	pthread_mutex_lock(&j->lock);
+	r->ready = 1;
+
+	if(j->busy) {
+		pthread_mutex_unlock(&j->lock);
+		return;
+	}
+
+	j->busy = 1;
+
+	while(j->next < j->nranges && j->ranges[j->next].ready) {
+		r = &j->ranges[j->next];
+
+		pthread_mutex_unlock(&j->lock);
+		par_deliver_index(j, r);
+		free(r->lines);
+		r->lines = NULL;
+		pthread_mutex_lock(&j->lock);
+
+		j->next++;
+		pthread_cond_broadcast(&j->moved);
+	}
+
+	j->busy = 0;
+	pthread_mutex_unlock(&j->lock);
+}
+
+/* cut the file into ranges starting at line starts */
+static int par_split(par_job *j, size_t nthreads)
+{
+	const char *nl;
+	size_t i, n, pos;
+
+	if(nthreads == 0)
+		nthreads = pool_cpus();
+
+	j->window = nthreads;
+
+	n = j->size / FILE_PAR_MIN_CHUNK;
+	if(n > nthreads * FILE_PAR_SPLIT)
+		n = nthreads * FILE_PAR_SPLIT;
+	if(n == 0)
+		n = 1;
+
+	if((j->ranges = calloc(n, sizeof(*j->ranges))) == NULL)
+		return(-1);
+
+	j->nranges = n;
+
+	for(i = 1; i < n; i++) {
+		pos = j->size / n * i;
+		if(pos < j->ranges[i - 1].begin)
+			pos = j->ranges[i - 1].begin;
+
+		/* a range starting right behind a newline is fine */
+		if(pos > 0 && (nl = memchr(j->data + pos - 1, '\n',
+					   j->size - pos + 1)) != NULL)
+			pos = nl + 1 - j->data;
+		else if(pos > 0)
+			pos = j->size;
+
+		j->ranges[i].begin   = pos;
+		j->ranges[i - 1].end = pos;
+	}
+
+	j->ranges[n - 1].end = j->size;
+
+	return(0);
+}
+
+/* the input can't be mapped: read it line by line */
+static int par_serial(const char *path, file_line_func *func, void *arg)
+{
+	line_reader *r;
+	size_t lineno = 0, len;
+	char *line;
+	int ret = 0;
+
+	if((r = line_reader_open(path)) == NULL)
+		return(-1);
+
+	while(ret == 0 && (line = line_reader_next(r, &len)) != NULL)
+		ret = func(arg, lineno++, line, len);
+
+	if(ret == 0 && line_reader_error(r))
+		ret = -1;
+
+	line_reader_destroy(r);
+
+	return(ret);
+}
+
+/* call func(arg, lineno, line, len) for every line of the file at path, on
+ * up to nthreads threads (0: one per processor). Lines are numbered from 0,
+ * include their newline and are not null-terminated. Without
+ * FILE_PAR_ORDERED, func is called concurrently from several threads, in
+ * file order within a range but in no particular order overall; with it,
+ * calls come one at a time, in file order. A nonzero return value of func
+ * stops the iteration (lines already being processed by other threads are
+ * still delivered in unordered mode) and is returned. Files that can't be
+ * mapped are processed serially. Returns 0 or -1 on error. */
+int file_foreach_line_parallel(const char *path, file_line_func *func,
+			       void *arg, size_t nthreads, int flags)
+{
+	struct stat st;
+	par_job j;
+	void *p = MAP_FAILED;
+	size_t i, lineno;
+	int fd, ret = -1;
+
+	assert(path != NULL);
+	assert(func != NULL);
+
+	do {
+		fd = open(path, O_RDONLY);
+	} while(fd < 0 && errno == EINTR);
+
+	if(fd < 0)
+		return(-1);
+
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	   (off_t)(size_t)st.st_size == st.st_size)
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+
+	if(p == MAP_FAILED)
+		return(par_serial(path, func, arg));
+
+	posix_madvise(p, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+	j.data   = p;
+	j.size   = st.st_size;
+	j.func   = func;
+	j.arg    = arg;
+	j.ranges = NULL;
+	j.next   = 0;
+	j.lineno = 0;
+	j.busy   = 0;
+	j.stop   = 0;
+	j.error  = 0;
+
+	if(pthread_mutex_init(&j.lock, NULL) != 0)
+		goto out;
+
+	if(pthread_cond_init(&j.moved, NULL) != 0) {
+		pthread_mutex_destroy(&j.lock);
+		goto out;
+	}
+
+	if(par_split(&j, nthreads) < 0)
+		goto unlock;
+
+	if(flags & FILE_PAR_ORDERED) {
+		if(pool_run(j.nranges, nthreads, par_ordered_range, &j) < 0)
+			goto unlock;
+	} else {
+		if(pool_run(j.nranges, nthreads, par_count_range, &j) < 0)
+			goto unlock;
+
+		for(i = 0, lineno = 0; i < j.nranges; i++) {
+			j.ranges[i].lineno = lineno;
+			lineno += j.ranges[i].nlines;
+		}
+
+		if(pool_run(j.nranges, nthreads, par_deliver_range, &j) < 0)
+			goto unlock;
+	}
+
+	ret = j.error ? -1 : j.stop;
+unlock:
+	if(j.ranges != NULL)
+		for(i = 0; i < j.nranges; i++)
+			free(j.ranges[i].lines);
+	free(j.ranges);
+	pthread_cond_destroy(&j.moved);
+	pthread_mutex_destroy(&j.lock);
+out:
+	munmap(p, st.st_size);
+
+	return(ret);
+}
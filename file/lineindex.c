@@ -0,0 +1,537 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Persistent line index. The offsets of the lines of a file are kept in a
+ * sidecar file (the file name plus LINE_INDEX_SUFFIX), so finding line n
+ * doesn't require reading the n lines before it.
+ *
+ * Lines are stored in groups of LINE_INDEX_INTERVAL. A group record holds
+ * the offset of its first line (8 bytes), the size of the rest of the
+ * record (4 bytes) and the lengths of its lines as varints (7 bits per
+ * byte, least significant first), which mostly takes one or two bytes per
+ * line. Finding a line means jumping to its group and adding up at most
+ * LINE_INDEX_INTERVAL - 1 lengths.
+ *
+ * The sidecar starts with a header holding the group size, the number of
+ * bytes and lines indexed and the size and modification time of the file
+ * at that time; all numbers are little-endian. Only complete lines are
+ * indexed. When the file has grown, only the new part is read; if it has
+ * shrunk or was rewritten, the index is built from scratch.
+ *
+ * When lines were appended, only the records from the last group on are
+ * written, then the header, so the sidecar costs about as much to update
+ * as the lines added. Updaters hold an exclusive flock() on the sidecar
+ * and readers a shared one. An updater that finds a header other than the
+ * one it last read or wrote rewrites the sidecar, truncating it first. A
+ * sidecar left half written by a crash doesn't decode exactly and is
+ * ignored. */
+
+#define _POSIX_C_SOURCE 200112L  /* read(), write(), lseek(), ftruncate() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "lineindex.h"
+#include "linereader.h"
+
+#define LINE_INDEX_MAGIC  "LIDX"
+#define LINE_INDEX_GROUP  12      /* offset, record size */
+
+static void put32(unsigned char *p, uint32_t v)
+{
+	int i;
+
+	for(i = 0; i < 4; i++, v >>= 8)
+		p[i] = (unsigned char)v;
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+	int i;
+
+	for(i = 0; i < 8; i++, v >>= 8)
+		p[i] = (unsigned char)v;
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+	return((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+	       (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+	return((uint64_t)get32(p) | (uint64_t)get32(p + 4) << 32);
+}
+
+/* decode the varint at *p, which must end before end and take at most 10
+ * bytes; returns -1 otherwise */
+static int get_varint(const unsigned char **p, const unsigned char *end,
+		      uint64_t *v)
+{
+	int shift;
+
+	for(*v = 0, shift = 0; *p < end && shift < 64; shift += 7) {
+		*v |= (uint64_t)(**p & 0x7f) << shift;
+		if((*(*p)++ & 0x80) == 0)
+			return(0);
+	}
+
+	return(-1);
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while(len > 0) {
+		if((n = read(fd, p, len)) < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return(-1);
+
+		p   += n;
+		len -= n;
+	}
+
+	return(0);
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while(len > 0) {
+		if((n = write(fd, p, len)) < 0) {
+			if(errno == EINTR)
+				continue;
+			return(-1);
+		}
+
+		p   += n;
+		len -= n;
+	}
+
+	return(0);
+}
+
+static int index_lock(int fd, int op)
+{
+	while(flock(fd, op) < 0)
+		if(errno != EINTR)
+			return(-1);
+
+	return(0);
+}
+
+static void index_reset(line_index *x)
+{
+	x->end     = 0;
+	x->fsize   = 0;
+	x->mtime   = 0;
+	x->nlines  = 0;
+	x->len     = 0;
+	x->ngroups = 0;
+	x->saved   = 0;
+}
+
+/* make room for n more bytes of data and one more group */
+static int index_reserve(line_index *x, size_t n)
+{
+	unsigned char *d;
+	size_t *g;
+
+	if(x->len + n > x->size) {
+		if((d = realloc(x->data, x->size * 2 + n)) == NULL)
+			return(-1);
+
+		x->data  = d;
+		x->size  = x->size * 2 + n;
+	}
+
+	if(x->ngroups == x->gsize) {
+		if((g = realloc(x->groups, sizeof(*g) * (x->gsize * 2 + 16))) == NULL)
+			return(-1);
+
+		x->groups = g;
+		x->gsize  = x->gsize * 2 + 16;
+	}
+
+	return(0);
+}
+
+static int index_add_line(line_index *x, uint64_t len)
+{
+	unsigned char *p;
+	size_t g;
+	uint64_t v;
+	int n = 0;
+
+	if(index_reserve(x, LINE_INDEX_GROUP + 10) < 0)
+		return(-1);
+
+	if(x->nlines % LINE_INDEX_INTERVAL == 0) {
+		x->groups[x->ngroups++] = x->len;
+		put64(x->data + x->len, x->end);
+		put32(x->data + x->len + 8, 0);
+		x->len += LINE_INDEX_GROUP;
+	}
+
+	p = x->data + x->len;
+	for(v = len; v >= 0x80; v >>= 7)
+		p[n++] = (unsigned char)(v | 0x80);
+	p[n++] = (unsigned char)v;
+
+	g = x->groups[x->ngroups - 1];
+	put32(x->data + g + 8, get32(x->data + g + 8) + n);
+	if(g < x->saved)
+		x->saved = g;
+
+	x->len    += n;
+	x->end    += len;
+	x->nlines += 1;
+
+	return(0);
+}
+
+/* index the complete lines of fd behind x->end */
+static int index_scan(line_index *x, int fd)
+{
+	line_reader *r;
+	char *line;
+	size_t len;
+	int ret = 0;
+
+	if(lseek(fd, (off_t)x->end, SEEK_SET) == (off_t)-1 ||
+	   (r = line_reader_init_fd(fd)) == NULL)
+		return(-1);
+
+	while((line = line_reader_next(r, &len)) != NULL) {
+		if(line[len - 1] != '\n')
+			break;
+
+		if(index_add_line(x, len) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+
+	if(line_reader_error(r))
+		ret = -1;
+
+	line_reader_destroy(r);
+
+	return(ret);
+}
+
+/* read the sidecar; returns -1 if it is missing or unusable */
+static int index_load(line_index *x)
+{
+	unsigned char hdr[LINE_INDEX_HEADER];
+	const unsigned char *p, *end;
+	struct stat st;
+	size_t pos, n, k;
+	uint64_t off, len, left;
+	int fd, ret = -1;
+
+	if((fd = open(x->sidecar, O_RDONLY)) < 0)
+		return(-1);
+
+	if(index_lock(fd, LOCK_SH) < 0 ||
+	   fstat(fd, &st) < 0 || st.st_size < LINE_INDEX_HEADER ||
+	   read_all(fd, hdr, LINE_INDEX_HEADER) < 0 ||
+	   memcmp(hdr, LINE_INDEX_MAGIC, 4) != 0 ||
+	   get32(hdr + 4) != LINE_INDEX_INTERVAL)
+		goto out;
+
+	n = st.st_size - LINE_INDEX_HEADER;
+	if((x->data = malloc(n + 1)) == NULL ||
+	   (n > 0 && read_all(fd, x->data, n) < 0))
+		goto out;
+
+	x->size   = n + 1;
+	x->len    = n;
+	x->end    = get64(hdr + 8);
+	x->fsize  = get64(hdr + 16);
+	x->mtime  = get64(hdr + 24);
+	x->nlines = get64(hdr + 32);
+
+	/* every group must take at least its fixed part */
+	n = (x->nlines + LINE_INDEX_INTERVAL - 1) / LINE_INDEX_INTERVAL;
+	if(n > x->len / LINE_INDEX_GROUP)
+		goto out;
+
+	if((x->groups = malloc(sizeof(*x->groups) * (n + 1))) == NULL)
+		goto out;
+
+	x->gsize = n + 1;
+
+	/* decode all groups: each must hold the lengths of exactly its lines,
+	 * adding up to the offset of the next group, and together they must
+	 * fill the data */
+	for(pos = 0, off = 0, left = x->nlines; x->ngroups < n; pos = p - x->data) {
+		if(x->len - pos < LINE_INDEX_GROUP || get64(x->data + pos) != off ||
+		   get32(x->data + pos + 8) > x->len - pos - LINE_INDEX_GROUP)
+			goto out;
+
+		p   = x->data + pos + LINE_INDEX_GROUP;
+		end = p + get32(x->data + pos + 8);
+
+		for(k = 0; k < LINE_INDEX_INTERVAL && k < left; k++) {
+			if(get_varint(&p, end, &len) < 0 || len == 0 ||
+			   len > x->end - off)
+				goto out;
+			off += len;
+		}
+
+		if(p != end)
+			goto out;
+
+		left -= k;
+		x->groups[x->ngroups++] = pos;
+	}
+
+	if(pos == x->len && off == x->end) {
+		memcpy(x->header, hdr, LINE_INDEX_HEADER);
+		x->saved = x->len;
+		ret = 0;
+	}
+out:
+	close(fd);
+
+	if(ret < 0)
+		index_reset(x);
+
+	return(ret);
+}
+
+/* write the records changed since the sidecar was last read or written,
+ * then the header; all of them if somebody else has changed it since */
+static int index_save(line_index *x)
+{
+	unsigned char hdr[LINE_INDEX_HEADER];
+	int fd, ret = -1;
+
+	if((fd = open(x->sidecar, O_RDWR | O_CREAT, 0666)) < 0)
+		return(-1);
+
+	if(index_lock(fd, LOCK_EX) < 0)
+		goto out;
+
+	if(x->saved > 0 &&
+	   (read_all(fd, hdr, LINE_INDEX_HEADER) < 0 ||
+	    memcmp(hdr, x->header, LINE_INDEX_HEADER) != 0))
+		x->saved = 0;
+
+	/* drop the old header first, so a crash can't leave it in front of
+	 * records it doesn't describe */
+	if(x->saved == 0 && ftruncate(fd, 0) < 0)
+		goto out;
+
+	memcpy(hdr, LINE_INDEX_MAGIC, 4);
+	put32(hdr + 4, LINE_INDEX_INTERVAL);
+	put64(hdr + 8, x->end);
+	put64(hdr + 16, x->fsize);
+	put64(hdr + 24, x->mtime);
+	put64(hdr + 32, x->nlines);
+
+	if(lseek(fd, (off_t)(LINE_INDEX_HEADER + x->saved), SEEK_SET) ==
+	   (off_t)-1 ||
+	   write_all(fd, x->data + x->saved, x->len - x->saved) < 0 ||
+	   ftruncate(fd, (off_t)(LINE_INDEX_HEADER + x->len)) < 0 ||
+	   lseek(fd, 0, SEEK_SET) == (off_t)-1 ||
+	   write_all(fd, hdr, LINE_INDEX_HEADER) < 0)
+		goto out;
+
+	memcpy(x->header, hdr, LINE_INDEX_HEADER);
+	x->saved = x->len;
+	ret = 0;
+out:
+	if(close(fd) < 0)
+		ret = -1;
+
+	return(ret);
+}
+
+/* nonzero if the indexed part of the file still ends with a newline */
+static int index_tail_ok(const line_index *x, int fd)
+{
+	char c;
+
+	if(x->end == 0)
+		return(1);
+
+	return(lseek(fd, (off_t)(x->end - 1), SEEK_SET) != (off_t)-1 &&
+	       read_all(fd, &c, 1) == 0 && c == '\n');
+}
+
+/* bring the index up to date with the file: lines appended since the last
+ * update are added, a file that shrank or was rewritten is indexed anew.
+ * The sidecar is updated if possible; failing to do so is no error, the
+ * index is still valid for this line_index. Returns -1 if the file can't
+ * be read. */
+int line_index_update(line_index *x)
+{
+	struct stat st;
+	uint64_t mtime;
+	int fd, ret = -1;
+
+	assert(x != NULL);
+
+	if((fd = open(x->path, O_RDONLY)) < 0)
+		return(-1);
+
+	if(fstat(fd, &st) < 0)
+		goto out;
+
+	mtime = (uint64_t)st.st_mtime;
+
+	if((uint64_t)st.st_size == x->fsize && mtime == x->mtime) {
+		ret = 0;
+		goto out;
+	}
+
+	if((uint64_t)st.st_size < x->end ||
+	   (uint64_t)st.st_size == x->fsize || !index_tail_ok(x, fd))
+		index_reset(x);
+
+	if(index_scan(x, fd) < 0) {
+		index_reset(x);
+		goto out;
+	}
+
+	x->fsize = st.st_size;
+	x->mtime = mtime;
+
+	index_save(x);
+	ret = 0;
+out:
+	close(fd);
+
+	return(ret);
+}
+
+/* open the index of the file at path, building or updating it (and its
+ * sidecar) as needed. Returns NULL on error. */
+line_index *line_index_open(const char *path)
+{
+	line_index *x;
+	size_t n;
+
+	assert(path != NULL);
+
+	if((x = calloc(1, sizeof(*x))) == NULL)
+		return(NULL);
+
+	n = strlen(path);
+	if((x->path = malloc(n + 1)) == NULL ||
+	   (x->sidecar = malloc(n + sizeof(LINE_INDEX_SUFFIX))) == NULL) {
+		line_index_destroy(x);
+		return(NULL);
+	}
+
+	memcpy(x->path, path, n + 1);
+	memcpy(x->sidecar, path, n);
+	memcpy(x->sidecar + n, LINE_INDEX_SUFFIX, sizeof(LINE_INDEX_SUFFIX));
+
+	index_load(x);
+
+	if(line_index_update(x) < 0) {
+		line_index_destroy(x);
+		return(NULL);
+	}
+
+	return(x);
+}
+
+void line_index_destroy(line_index *x)
+{
+	if(x == NULL)
+		return;
+
+	free(x->path);
+	free(x->sidecar);
+	free(x->data);
+	free(x->groups);
+	free(x);
+}
+
+/* number of lines, including a last line without newline */
+uint64_t line_index_lines(const line_index *x)
+{
+	assert(x != NULL);
+
+	return(x->nlines + (x->fsize > x->end));
+}
+
+/* find line n (counting from 0) and store its offset in the file and its
+ * length, including the newline, in offset and len (if not NULL). Returns
+ * -1 if there is no such line. */
+int line_index_find(const line_index *x, uint64_t n,
+		    uint64_t *offset, size_t *len)
+{
+	const unsigned char *p, *end;
+	uint64_t off, l;
+	size_t i;
+
+	assert(x != NULL);
+
+	if(n < x->nlines) {
+		p   = x->data + x->groups[n / LINE_INDEX_INTERVAL];
+		off = get64(p);
+		end = p + LINE_INDEX_GROUP + get32(p + 8);
+		p  += LINE_INDEX_GROUP;
+
+		/* the records were checked when loaded or built */
+		for(i = 0; i < n % LINE_INDEX_INTERVAL; i++) {
+			get_varint(&p, end, &l);
+			off += l;
+		}
+
+		get_varint(&p, end, &l);
+	} else if(n == x->nlines && x->fsize > x->end) {
+		off = x->end;
+		l   = x->fsize - x->end;
+	} else {
+		return(-1);
+	}
+
+	if(offset != NULL)
+		*offset = off;
+	if(len != NULL)
+		*len = (size_t)l;
+
+	return(0);
+}
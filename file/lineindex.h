@@ -0,0 +1,59 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LINEINDEX_H_
+#define LINEINDEX_H_
+
+#include <stdint.h>
+
+#define LINE_INDEX_INTERVAL 64
+#define LINE_INDEX_SUFFIX   ".lidx"
+#define LINE_INDEX_HEADER   40    /* magic, interval, 4 numbers */
+
+typedef struct line_index_ {
+	char *path;            /* indexed file */
+	char *sidecar;         /* where the index is stored */
+	uint64_t end;          /* bytes of complete lines indexed */
+	uint64_t fsize;        /* file size when last indexed */
+	uint64_t mtime;
+	uint64_t nlines;       /* complete lines indexed */
+	unsigned char *data;   /* group records, as stored */
+	size_t len;
+	size_t size;
+	size_t *groups;        /* position of every group record in data */
+	size_t ngroups;
+	size_t gsize;
+	size_t saved;          /* data unchanged since last read or written */
+	unsigned char header[LINE_INDEX_HEADER];  /* sidecar header then */
+} line_index;
+
+line_index *line_index_open(const char *path);
+int         line_index_update(line_index *x);
+void        line_index_destroy(line_index *x);
+uint64_t    line_index_lines(const line_index *x);
+int         line_index_find(const line_index *x, uint64_t n,
+			    uint64_t *offset, size_t *len);
+
+#endif  /* ! LINEINDEX_H_ */
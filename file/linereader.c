@@ -0,0 +1,430 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Buffered line reader. Input is read in large blocks into a buffer which
+ * doubles whenever a line doesn't fit; newlines are found with memchr().
+ * Lines are handed out in place, terminated by overwriting the first byte
+ * of the next line, which is put back on the following call. Bytes already
+ * searched are never searched again, so reading is linear in the input
+ * size even for very long lines.
+ *
+ * With LINE_READER_CRLF, lines end at LF, CRLF or a lone CR, so files from
+ * any platform (or a mix of them) are read in one pass; the buffer is then
+ * searched for either character with SSE2 or AVX2 where available. A CR at
+ * the end of the buffered data is only taken for a line end once the next
+ * byte is known. LINE_READER_STRIP drops the terminators by overwriting
+ * them with the null character.
+ *
+ * Input that is still being written, such as a log file, is read with
+ * LINE_READER_FOLLOW: at the end of the input an unterminated last line is
+ * kept in the buffer instead of being returned, and after
+ * line_reader_clear_eof() reading goes on where it stopped. */
+
+#define _POSIX_C_SOURCE 200112L  /* close() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "linereader.h"
+#include "fileio.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINE_READER_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* a word of bytes c */
+#define EOL_WORD(c) ((~0UL / 255) * (c))
+
+/* nonzero if a byte of w is zero */
+#define EOL_ZERO(w) (((w) - EOL_WORD(0x01)) & ~(w) & EOL_WORD(0x80))
+
+/* find the first CR or LF in [p, end) */
+static const char *eol_scan_scalar(const char *p, const char *end)
+{
+	unsigned long w;
+
+	for(; (size_t)(end - p) >= sizeof(w); p += sizeof(w)) {
+		memcpy(&w, p, sizeof(w));
+
+		if(EOL_ZERO(w ^ EOL_WORD('\n')) | EOL_ZERO(w ^ EOL_WORD('\r')))
+			break;
+	}
+
+	for(; p < end; p++)
+		if(*p == '\n' || *p == '\r')
+			return(p);
+
+	return(NULL);
+}
+
+#ifdef LINE_READER_SIMD
+
+#define LINE_READER_SSE2 __attribute__((target("sse2")))
+#define LINE_READER_AVX2 __attribute__((target("avx2")))
+
+LINE_READER_SSE2 static const char *eol_scan_sse2(const char *p,
+						  const char *end)
+{
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	__m128i x;
+	int m;
+
+	for(; end - p >= 16; p += 16) {
+		x = _mm_loadu_si128((const __m128i *)p);
+		m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, lf),
+						   _mm_cmpeq_epi8(x, cr)));
+		if(m != 0)
+			return(p + __builtin_ctz(m));
+	}
+
+	return(eol_scan_scalar(p, end));
+}
+
+LINE_READER_AVX2 static const char *eol_scan_avx2(const char *p,
+						  const char *end)
+{
+	const __m256i lf = _mm256_set1_epi8('\n');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	__m256i x;
+	unsigned m;
+
+	for(; end - p >= 32; p += 32) {
+		x = _mm256_loadu_si256((const __m256i *)p);
+		m = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_cmpeq_epi8(x, lf), _mm256_cmpeq_epi8(x, cr)));
+		if(m != 0)
+			return(p + __builtin_ctz(m));
+	}
+
+	return(eol_scan_sse2(p, end));
+}
+
+#endif  /* LINE_READER_SIMD */
+
+static const char *eol_scan_init(const char *, const char *);
+
+static const char *(*eol_scan)(const char *, const char *) = eol_scan_init;
+
+static void eol_select(void)
+{
+	eol_scan = eol_scan_scalar;
+
+#ifdef LINE_READER_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2"))
+		eol_scan = eol_scan_avx2;
+	else if(__builtin_cpu_supports("sse2"))
+		eol_scan = eol_scan_sse2;
+#endif
+}
+
+static const char *eol_scan_init(const char *p, const char *end)
+{
+	eol_select();
+	return(eol_scan(p, end));
+}
+
+static line_reader *line_reader_new(void)
+{
+	line_reader *r;
+
+	if((r = malloc(sizeof(*r))) == NULL)
+		return(NULL);
+
+	if((r->buf = malloc(LINE_READER_BLOCK_SIZE + 1)) == NULL) {
+		free(r);
+		return(NULL);
+	}
+
+	r->fp    = NULL;
+	r->fd    = -1;
+	r->own   = 0;
+	r->size  = LINE_READER_BLOCK_SIZE;
+	r->pos   = 0;
+	r->end   = 0;
+	r->scan  = 0;
+	r->hold  = -1;
+	r->flags = 0;
+	r->eof   = 0;
+	r->error = 0;
+
+	return(r);
+}
+
+/* read lines from fp. The reader reads ahead, so fp shouldn't be used
+ * directly anymore; it isn't closed by line_reader_destroy(). */
+line_reader *line_reader_init(FILE *fp)
+{
+	line_reader *r;
+
+	assert(fp != NULL);
+
+	if((r = line_reader_new()) == NULL)
+		return(NULL);
+
+	r->read = file_read_block;
+	r->ctx  = r->fp = fp;
+
+	return(r);
+}
+
+/* same as line_reader_init(), but on a file descriptor */
+line_reader *line_reader_init_fd(int fd)
+{
+	line_reader *r;
+
+	if((r = line_reader_new()) == NULL)
+		return(NULL);
+
+	r->read = file_read_block_fd;
+	r->fd   = fd;
+	r->ctx  = &r->fd;
+
+	return(r);
+}
+
+/* read lines from whatever read(ctx, buf, len) delivers. read() stores up
+ * to len bytes at buf and returns their number, 0 at the end of the input
+ * or -1 on error. */
+line_reader *line_reader_init_func(long (*read)(void *, void *, size_t),
+				   void *ctx)
+{
+	line_reader *r;
+
+	assert(read != NULL);
+
+	if((r = line_reader_new()) == NULL)
+		return(NULL);
+
+	r->read = read;
+	r->ctx  = ctx;
+
+	return(r);
+}
+
+/* read lines from the file at path, which is closed by
+ * line_reader_destroy() */
+line_reader *line_reader_open(const char *path)
+{
+	line_reader *r;
+	int fd;
+
+	assert(path != NULL);
+
+	do {
+		fd = open(path, O_RDONLY);
+	} while(fd < 0 && errno == EINTR);
+
+	if(fd < 0)
+		return(NULL);
+
+	if((r = line_reader_init_fd(fd)) == NULL) {
+		close(fd);
+		return(NULL);
+	}
+
+	r->own = 1;
+
+	return(r);
+}
+
+void line_reader_destroy(line_reader *r)
+{
+	if(r == NULL)
+		return;
+
+	if(r->own)
+		close(r->fd);
+
+	free(r->buf);
+	free(r);
+}
+
+/* set LINE_READER_CRLF, LINE_READER_STRIP and LINE_READER_FOLLOW; takes
+ * effect with the next line */
+void line_reader_set_flags(line_reader *r, int flags)
+{
+	assert(r != NULL);
+
+	r->flags = flags;
+	r->scan  = 0;
+}
+
+/* forget that the end of the input was reached, so that the next call
+ * reads again; for input that grows */
+void line_reader_clear_eof(line_reader *r)
+{
+	assert(r != NULL);
+
+	r->eof = 0;
+}
+
+/* make room at the end of the buffer and read another block */
+static int line_reader_fill(line_reader *r)
+{
+	char *tmp;
+	long n;
+
+	if(r->end == r->size) {
+		if(r->pos > 0) {
+			memmove(r->buf, r->buf + r->pos, r->end - r->pos);
+			r->end -= r->pos;
+			r->pos  = 0;
+		} else {
+			if((tmp = realloc(r->buf, r->size * 2 + 1)) == NULL) {
+				r->error = 1;
+				return(-1);
+			}
+
+			r->buf   = tmp;
+			r->size *= 2;
+		}
+	}
+
+	if((n = r->read(r->ctx, r->buf + r->end, r->size - r->end)) < 0) {
+		r->error = 1;
+		return(-1);
+	}
+
+	if(n == 0)
+		r->eof = 1;
+
+	r->end += n;
+
+	return(0);
+}
+
+/* return the next line, null-terminated and including its terminator
+ * (unless there is none or it is stripped), and store its length in len
+ * (if not NULL). The line lives in the reader's buffer and is valid up to
+ * the next call; it may be modified in place. Returns NULL at the end of
+ * the input or on error. */
+char *line_reader_next(line_reader *r, size_t *len)
+{
+	const char *nl, *end;
+	char *line;
+	size_t n, term = 0;
+	int last;
+
+	assert(r != NULL);
+
+	if(r->hold >= 0) {
+		r->buf[r->pos] = (char)r->hold;
+		r->hold = -1;
+	}
+
+	for(;;) {
+		line = r->buf + r->pos;
+		end  = r->buf + r->end;
+
+		if(r->flags & LINE_READER_CRLF)
+			nl = eol_scan(line + r->scan, end);
+		else
+			nl = memchr(line + r->scan, '\n', end - line - r->scan);
+
+		/* nothing more comes behind the buffered data */
+		last = r->eof && !(r->flags & LINE_READER_FOLLOW);
+
+		/* a CR at the very end may be the first half of a CRLF */
+		if(nl != NULL && (*nl == '\n' || nl + 1 < end || last)) {
+			term = (*nl == '\r' && nl + 1 < end && nl[1] == '\n') ? 2 : 1;
+			n    = nl + term - line;
+			break;
+		}
+
+		r->scan = (nl != NULL ? nl : end) - line;
+
+		if(r->eof) {
+			if((n = r->scan) == 0 || !last)
+				return(NULL);
+			break;
+		}
+
+		if(line_reader_fill(r) < 0)
+			return(NULL);
+	}
+
+	r->pos  += n;
+	r->scan  = 0;
+
+	if(r->flags & LINE_READER_STRIP) {
+		n -= term;
+	} else if(r->pos < r->end) {
+		r->hold = (unsigned char)r->buf[r->pos];
+	}
+
+	line[n] = '\0';
+
+	if(len != NULL)
+		*len = n;
+
+	return(line);
+}
+
+/* copy the next line to *line, which is a malloc()ed buffer of *size bytes
+ * (or NULL) and is grown as needed. Returns the length of the line, or -1
+ * at the end of the input or on error (see line_reader_error()). */
+long line_reader_getline(line_reader *r, char **line, size_t *size)
+{
+	size_t n, want;
+	char *p, *tmp;
+
+	assert(line != NULL);
+	assert(size != NULL);
+
+	if((p = line_reader_next(r, &n)) == NULL)
+		return(-1);
+
+	if(*line == NULL || *size < n + 1) {
+		want = *line == NULL ? 0 : *size * 2;
+		if(want < n + 1)
+			want = n + 1;
+
+		if((tmp = realloc(*line, want)) == NULL) {
+			r->error = 1;
+			return(-1);
+		}
+
+		*line = tmp;
+		*size = want;
+	}
+
+	memcpy(*line, p, n + 1);
+
+	return((long)n);
+}
+
+/* returns nonzero if reading failed */
+int line_reader_error(const line_reader *r)
+{
+	return(r->error);
+}
@@ -0,0 +1,64 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LINEREADER_H_
+#define LINEREADER_H_
+
+#define LINE_READER_BLOCK_SIZE 65536
+
+#define LINE_READER_CRLF       0x01   /* lines also end at CRLF and CR */
+#define LINE_READER_STRIP      0x02   /* remove line terminators */
+#define LINE_READER_FOLLOW     0x04   /* keep back an unterminated last line */
+
+typedef struct line_reader_ {
+	long (*read)(void *ctx, void *buf, size_t len);
+	void *ctx;
+	FILE *fp;
+	int fd;
+	int own;            /* fd was opened by line_reader_open() */
+	char *buf;
+	size_t size;        /* capacity of buf, not counting the terminator */
+	size_t pos;         /* start of the next line */
+	size_t end;         /* end of the buffered data */
+	size_t scan;        /* bytes after pos known to hold no newline */
+	int hold;           /* character under the last line's terminator */
+	int flags;
+	int eof;
+	int error;
+} line_reader;
+
+line_reader *line_reader_init(FILE *fp);
+line_reader *line_reader_init_fd(int fd);
+line_reader *line_reader_init_func(long (*read)(void *, void *, size_t),
+				   void *ctx);
+line_reader *line_reader_open(const char *path);
+void         line_reader_destroy(line_reader *r);
+void         line_reader_set_flags(line_reader *r, int flags);
+void         line_reader_clear_eof(line_reader *r);
+char        *line_reader_next(line_reader *r, size_t *len);
+long         line_reader_getline(line_reader *r, char **line, size_t *size);
+int          line_reader_error(const line_reader *r);
+
+#endif  /* ! LINEREADER_H_ */
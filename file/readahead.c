@@ -0,0 +1,354 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Read-ahead for sequential scans. A background thread reads the file
+ * block by block with pread() into a ring of buffers (three by default)
+ * while the consumer works on the block before; the consumer only waits if
+ * it is faster than the disk, and the time it spends waiting is recorded.
+ * Descriptors that can't pread() (pipes) are read with read() instead, after
+ * poll() on them and on a pipe that readahead_destroy() writes to, so a
+ * thread waiting for input that may never come can still be stopped.
+ * readahead_line_reader() puts a line_reader on top, so the usual line
+ * interface is available. */
+
+#define _POSIX_C_SOURCE 200809L  /* pread(), clock_gettime(), poll() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "readahead.h"
+#include "linereader.h"
+
+struct readahead_ {
+	int fd;
+	int own;               /* fd was opened by readahead_open() */
+	int seekable;          /* pread() works on fd */
+	int wake[2];           /* written to by readahead_destroy() */
+	off_t off;             /* where the next block is read from */
+	char *bufs;
+	long *lens;            /* bytes in every buffer, 0 at EOF, -1 on error */
+	size_t nbufs;
+	size_t bsize;
+	size_t head;           /* blocks read by the thread */
+	size_t tail;           /* blocks used up by the consumer */
+	size_t pos;            /* consumer position within block tail */
+	int quit;
+	pthread_t tid;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	readahead_stats stats;
+};
+
+static double ra_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* wait until fd has input; returns 0 if the thread is to quit instead */
+static int ra_poll(readahead *ra)
+{
+	struct pollfd pfd[2];
+
+	pfd[0].fd     = ra->fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd     = ra->wake[0];
+	pfd[1].events = POLLIN;
+
+	while(poll(pfd, 2, -1) < 0)
+		if(errno != EINTR)
+			return(1);  /* let read() report the problem */
+
+	return(pfd[1].revents == 0);
+}
+
+static long ra_read_block(readahead *ra, char *buf)
+{
+	ssize_t n;
+
+	do {
+		if(ra->seekable)
+			n = pread(ra->fd, buf, ra->bsize, ra->off);
+		else if(!ra_poll(ra))
+			return(0);
+		else
+			n = read(ra->fd, buf, ra->bsize);
+
+		if(n < 0 && errno == ESPIPE && ra->seekable) {
+			ra->seekable = 0;
+			errno = EINTR;
+		}
+	} while(n < 0 && errno == EINTR);
+
+	if(n > 0)
+		ra->off += n;
+
+	return((long)n);
+}
+
+static void *ra_thread(void *arg)
+{
+	readahead *ra = arg;
+	size_t slot;
+	double t;
+	long n;
+
+	pthread_mutex_lock(&ra->lock);
+
+	for(;;) {
+		if(!ra->quit && ra->head - ra->tail == ra->nbufs) {
+			t = ra_now();
+			while(!ra->quit && ra->head - ra->tail == ra->nbufs)
+				pthread_cond_wait(&ra->cond, &ra->lock);
+			ra->stats.idle += ra_now() - t;
+		}
+
+		if(ra->quit)
+			break;
+
+		slot = ra->head % ra->nbufs;
+		pthread_mutex_unlock(&ra->lock);
+
+		n = ra_read_block(ra, ra->bufs + slot * ra->bsize);
+
+		pthread_mutex_lock(&ra->lock);
+		ra->lens[slot] = n;
+		ra->head++;
+		ra->stats.blocks += (n > 0);
+		pthread_cond_broadcast(&ra->cond);
+
+		/* the end of file or error stays in its buffer */
+		if(n <= 0)
+			break;
+	}
+
+	pthread_mutex_unlock(&ra->lock);
+
+	return(NULL);
+}
+
+/* read the file open on fd from its current offset on, using nbufs buffers
+ * of bsize bytes (0 for the defaults). fd isn't closed by
+ * readahead_destroy(). Returns NULL on error. */
+readahead *readahead_init_fd(int fd, size_t nbufs, size_t bsize)
+{
+	readahead *ra;
+
+	if((ra = calloc(1, sizeof(*ra))) == NULL)
+		return(NULL);
+
+	ra->fd    = fd;
+	ra->nbufs = nbufs ? nbufs : READAHEAD_BUFFERS;
+	ra->bsize = bsize ? bsize : READAHEAD_BLOCK_SIZE;
+
+	if((ra->off = lseek(fd, 0, SEEK_CUR)) != (off_t)-1)
+		ra->seekable = 1;
+	else
+		ra->off = 0;
+
+	if((ra->bufs = malloc(ra->nbufs * ra->bsize)) == NULL ||
+	   (ra->lens = malloc(ra->nbufs * sizeof(*ra->lens))) == NULL)
+		goto fail;
+
+	if(pipe(ra->wake) < 0)
+		goto fail;
+
+	if(pthread_mutex_init(&ra->lock, NULL) != 0)
+		goto unpipe;
+
+	if(pthread_cond_init(&ra->cond, NULL) != 0) {
+		pthread_mutex_destroy(&ra->lock);
+		goto unpipe;
+	}
+
+	if(pthread_create(&ra->tid, NULL, ra_thread, ra) != 0) {
+		pthread_cond_destroy(&ra->cond);
+		pthread_mutex_destroy(&ra->lock);
+		goto unpipe;
+	}
+
+	return(ra);
+unpipe:
+	close(ra->wake[0]);
+	close(ra->wake[1]);
+fail:
+	free(ra->bufs);
+	free(ra->lens);
+	free(ra);
+
+	return(NULL);
+}
+
+/* read the file at path, which is closed by readahead_destroy() */
+readahead *readahead_open(const char *path, size_t nbufs, size_t bsize)
+{
+	readahead *ra;
+	int fd;
+
+	assert(path != NULL);
+
+	do {
+		fd = open(path, O_RDONLY);
+	} while(fd < 0 && errno == EINTR);
+
+	if(fd < 0)
+		return(NULL);
+
+	if((ra = readahead_init_fd(fd, nbufs, bsize)) == NULL) {
+		close(fd);
+		return(NULL);
+	}
+
+	ra->own = 1;
+
+	return(ra);
+}
+
+void readahead_destroy(readahead *ra)
+{
+	if(ra == NULL)
+		return;
+
+	pthread_mutex_lock(&ra->lock);
+	ra->quit = 1;
+	pthread_cond_broadcast(&ra->cond);
+	pthread_mutex_unlock(&ra->lock);
+
+	/* the thread may sit in poll() */
+	while(write(ra->wake[1], "", 1) < 0 && errno == EINTR)
+		;
+
+	pthread_join(ra->tid, NULL);
+	pthread_cond_destroy(&ra->cond);
+	pthread_mutex_destroy(&ra->lock);
+	close(ra->wake[0]);
+	close(ra->wake[1]);
+
+	if(ra->own)
+		close(ra->fd);
+
+	free(ra->bufs);
+	free(ra->lens);
+	free(ra);
+}
+
+/* copy up to len bytes of the file to buf; returns their number, 0 at the
+ * end of the file or -1 on error. Waits if the next block isn't there
+ * yet. */
+long readahead_read(readahead *ra, char *buf, size_t len)
+{
+	size_t slot, n;
+	double t;
+	long have;
+
+	assert(ra  != NULL);
+	assert(buf != NULL);
+
+	pthread_mutex_lock(&ra->lock);
+
+	if(ra->tail == ra->head) {
+		t = ra_now();
+		while(ra->tail == ra->head)
+			pthread_cond_wait(&ra->cond, &ra->lock);
+		ra->stats.stall += ra_now() - t;
+		ra->stats.stalls++;
+	}
+
+	slot = ra->tail % ra->nbufs;
+	have = ra->lens[slot];
+
+	if(have <= 0) {
+		pthread_mutex_unlock(&ra->lock);
+		return(have);
+	}
+
+	n = (size_t)have - ra->pos;
+	if(n > len)
+		n = len;
+
+	ra->stats.bytes += n;
+	pthread_mutex_unlock(&ra->lock);
+
+	/* the thread leaves this buffer alone until tail moves on */
+	memcpy(buf, ra->bufs + slot * ra->bsize + ra->pos, n);
+	ra->pos += n;
+
+	if(ra->pos == (size_t)have) {
+		pthread_mutex_lock(&ra->lock);
+		ra->tail++;
+		ra->pos = 0;
+		pthread_cond_broadcast(&ra->cond);
+		pthread_mutex_unlock(&ra->lock);
+	}
+
+	return((long)n);
+}
+
+void readahead_get_stats(readahead *ra, readahead_stats *st)
+{
+	assert(ra != NULL);
+	assert(st != NULL);
+
+	pthread_mutex_lock(&ra->lock);
+	*st = ra->stats;
+	pthread_mutex_unlock(&ra->lock);
+}
+
+void readahead_print_stats(readahead *ra)
+{
+	readahead_stats st;
+
+	readahead_get_stats(ra, &st);
+
+	printf("read:  %lu bytes in %lu blocks\n",
+	       (unsigned long)st.bytes, (unsigned long)st.blocks);
+	printf("stall: %.3f s in %lu waits, reader idle %.3f s\n",
+	       st.stall, (unsigned long)st.stalls, st.idle);
+}
+
+static long ra_line_read(void *ctx, void *buf, size_t len)
+{
+	return(readahead_read(ctx, buf, len));
+}
+
+/* a line_reader on top of ra; destroy it before ra */
+line_reader *readahead_line_reader(readahead *ra)
+{
+	assert(ra != NULL);
+
+	return(line_reader_init_func(ra_line_read, ra));
+}
@@ -0,0 +1,55 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef READAHEAD_H_
+#define READAHEAD_H_
+
+#include <stdint.h>
+
+#define READAHEAD_BLOCK_SIZE 1048576
+#define READAHEAD_BUFFERS    3
+
+struct line_reader_;
+
+typedef struct readahead_ readahead;
+
+typedef struct readahead_stats_ {
+	uint64_t bytes;     /* bytes handed to the consumer */
+	size_t blocks;      /* blocks read by the reader thread */
+	size_t stalls;      /* times the consumer had to wait for a block */
+	double stall;       /* seconds the consumer spent waiting */
+	double idle;        /* seconds the reader thread waited for a buffer */
+} readahead_stats;
+
+readahead *readahead_open(const char *path, size_t nbufs, size_t bsize);
+readahead *readahead_init_fd(int fd, size_t nbufs, size_t bsize);
+void       readahead_destroy(readahead *ra);
+long       readahead_read(readahead *ra, char *buf, size_t len);
+void       readahead_get_stats(readahead *ra, readahead_stats *st);
+void       readahead_print_stats(readahead *ra);
+
+struct line_reader_ *readahead_line_reader(readahead *ra);
+
+#endif  /* ! READAHEAD_H_ */
@@ -0,0 +1,349 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Following a growing file, like tail -F. The file is read through a
+ * line_reader with LINE_READER_FOLLOW, so only complete lines are returned
+ * and a trailing partial line waits in the buffer until the rest of it has
+ * been written. When no complete line is available, the reader sleeps until
+ * the file changes, which it learns from inotify on Linux and by polling
+ * every TAIL_POLL_INTERVAL ms elsewhere (or if inotify fails).
+ *
+ * Whenever the file has nothing new, its name is checked: if it now refers
+ * to a different inode the file was rotated, so the rest of the old file
+ * is returned (including a last line without newline) and reading goes on
+ * at the start of the new one. A file that got shorter than what was read
+ * was truncated and is read again from the start. */
+
+#define _POSIX_C_SOURCE 200112L  /* read(), nanosleep(), clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "tail.h"
+#include "linereader.h"
+#include "fileio.h"
+
+#define TAIL_TRUNCATED 1
+#define TAIL_ROTATED   2
+
+struct tail_ {
+	char *path;
+	char *dir;             /* directory holding path */
+	int fd;                /* -1 while the file doesn't exist */
+	dev_t dev;
+	ino_t ino;
+	off_t off;             /* bytes of the file read so far */
+	line_reader *r;
+	int skip;              /* the first line is the end of a partial one */
+	int ifd;               /* inotify descriptor or -1 */
+	int wfile;             /* inotify watches or -1 */
+	int wdir;
+	int error;
+};
+
+static long tail_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return(ts.tv_sec * 1000L + ts.tv_nsec / 1000000L);
+}
+
+/* read callback of the line reader; a missing file has nothing to read */
+static long tail_read(void *ctx, void *buf, size_t len)
+{
+	tail *t = ctx;
+	long n;
+
+	if(t->fd < 0)
+		return(0);
+
+	if((n = file_read_block_fd(&t->fd, buf, len)) > 0)
+		t->off += n;
+
+	return(n);
+}
+
+/* (re)open the file and watch it */
+static void tail_reopen(tail *t)
+{
+	struct stat st;
+
+	if(t->fd >= 0)
+		close(t->fd);
+
+	t->off  = 0;
+	t->skip = 0;
+
+	if((t->fd = open(t->path, O_RDONLY)) < 0)
+		return;
+
+	if(fstat(t->fd, &st) < 0) {
+		close(t->fd);
+		t->fd = -1;
+		return;
+	}
+
+	t->dev = st.st_dev;
+	t->ino = st.st_ino;
+
+#ifdef __linux__
+	if(t->ifd >= 0) {
+		if(t->wfile >= 0)
+			inotify_rm_watch(t->ifd, t->wfile);
+
+		t->wfile = inotify_add_watch(t->ifd, t->path, IN_MODIFY |
+					     IN_ATTRIB | IN_MOVE_SELF |
+					     IN_DELETE_SELF);
+	}
+#endif
+}
+
+/* start reading at the end of the file. A last line without newline is
+ * probably still being written, so its end isn't taken for a line. */
+static void tail_seek_end(tail *t)
+{
+	char c;
+
+	if(lseek(t->fd, -1, SEEK_END) != (off_t)-1 && read(t->fd, &c, 1) == 1)
+		t->skip = (c != '\n');
+
+	if((t->off = lseek(t->fd, 0, SEEK_CUR)) == (off_t)-1)
+		t->off = 0;
+}
+
+/* follow the file at path. Reading starts at the current end of the file
+ * (with the first line that begins after it), or with TAIL_FROM_START at
+ * its beginning. The file doesn't have to exist yet. Returns NULL on
+ * error. */
+tail *tail_open(const char *path, int flags)
+{
+	const char *slash;
+	size_t n;
+	tail *t;
+
+	assert(path != NULL);
+
+	if((t = calloc(1, sizeof(*t))) == NULL)
+		return(NULL);
+
+	t->fd    = -1;
+	t->ifd   = -1;
+	t->wfile = -1;
+	t->wdir  = -1;
+
+	n = strlen(path);
+	if((t->path = malloc(n + 1)) == NULL ||
+	   (t->dir = malloc(n + 2)) == NULL ||
+	   (t->r = line_reader_init_func(tail_read, t)) == NULL) {
+		tail_destroy(t);
+		return(NULL);
+	}
+
+	line_reader_set_flags(t->r, LINE_READER_FOLLOW);
+
+	memcpy(t->path, path, n + 1);
+
+	if((slash = strrchr(path, '/')) == NULL) {
+		strcpy(t->dir, ".");
+	} else {
+		n = (slash == path) ? 1 : (size_t)(slash - path);
+		memcpy(t->dir, path, n);
+		t->dir[n] = '\0';
+	}
+
+#ifdef __linux__
+	/* rotation shows in the directory as a new file of the same name */
+	if((t->ifd = inotify_init()) >= 0) {
+		t->wdir = inotify_add_watch(t->ifd, t->dir,
+					    IN_CREATE | IN_MOVED_TO);
+		fcntl(t->ifd, F_SETFL, O_NONBLOCK);
+	}
+#endif
+
+	tail_reopen(t);
+
+	if(t->fd >= 0 && (flags & TAIL_FROM_START) == 0)
+		tail_seek_end(t);
+
+	return(t);
+}
+
+void tail_destroy(tail *t)
+{
+	if(t == NULL)
+		return;
+
+	if(t->fd >= 0)
+		close(t->fd);
+	if(t->ifd >= 0)
+		close(t->ifd);
+
+	line_reader_destroy(t->r);
+	free(t->path);
+	free(t->dir);
+	free(t);
+}
+
+/* look for rotation and truncation */
+static int tail_check(tail *t)
+{
+	struct stat st;
+
+	if(stat(t->path, &st) < 0)
+		return(0);
+
+	if(t->fd < 0 || st.st_dev != t->dev || st.st_ino != t->ino)
+		return(TAIL_ROTATED);
+
+	if(fstat(t->fd, &st) == 0 && st.st_size < t->off)
+		return(TAIL_TRUNCATED);
+
+	return(0);
+}
+
+/* take what is left in the buffer of the current file, even without
+ * newline; the reader must be at the end of the input */
+static char *tail_rest(tail *t, size_t *len)
+{
+	char *line;
+
+	line_reader_set_flags(t->r, 0);
+	line = line_reader_next(t->r, len);
+	line_reader_set_flags(t->r, LINE_READER_FOLLOW);
+	line_reader_clear_eof(t->r);
+
+	return(line);
+}
+
+/* sleep until the file might have changed, but no longer than ms (-1:
+ * forever) */
+static void tail_wait(tail *t, long ms)
+{
+	struct timespec ts;
+	char ev[4096];
+
+#ifdef __linux__
+	struct pollfd p;
+
+	if(t->ifd >= 0 && t->wdir >= 0 && (t->wfile >= 0 || t->fd < 0)) {
+		p.fd     = t->ifd;
+		p.events = POLLIN;
+
+		if(poll(&p, 1, (int)ms) > 0)
+			while(read(t->ifd, ev, sizeof(ev)) > 0)
+				;
+		return;
+	}
+#endif
+	(void)ev;
+
+	if(ms < 0 || ms > TAIL_POLL_INTERVAL)
+		ms = TAIL_POLL_INTERVAL;
+
+	ts.tv_sec  = ms / 1000;
+	ts.tv_nsec = ms % 1000 * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+/* return the next new line of the file, including its newline and
+ * null-terminated, and store its length in len (if not NULL). The line
+ * lives in the reader's buffer and is valid up to the next call. If there
+ * is no complete line, waits up to timeout ms for one (-1: forever, 0:
+ * don't wait). Returns NULL on timeout or error (see tail_error()). */
+char *tail_next(tail *t, size_t *len, int timeout)
+{
+	long until = 0, left = -1;
+	char *line;
+	int skip;
+
+	assert(t != NULL);
+
+	if(timeout > 0)
+		until = tail_ms() + timeout;
+
+	for(;;) {
+		/* the old file is drained before looking for a new one */
+		if((line = line_reader_next(t->r, len)) != NULL) {
+			if(t->skip) {
+				t->skip = 0;
+				continue;
+			}
+			return(line);
+		}
+
+		if(line_reader_error(t->r)) {
+			t->error = 1;
+			return(NULL);
+		}
+
+		switch(tail_check(t)) {
+		case TAIL_ROTATED:
+			skip = t->skip;
+			line = tail_rest(t, len);
+			tail_reopen(t);
+
+			if(line != NULL && !skip)
+				return(line);
+			continue;
+
+		case TAIL_TRUNCATED:
+			/* the rest of the line before truncation is gone for
+			 * good */
+			if(lseek(t->fd, 0, SEEK_SET) == (off_t)-1)
+				break;
+
+			tail_rest(t, NULL);
+			t->off  = 0;
+			t->skip = 0;
+			continue;
+		}
+
+		line_reader_clear_eof(t->r);
+
+		if(timeout == 0 || (timeout > 0 && (left = until - tail_ms()) <= 0))
+			return(NULL);
+
+		tail_wait(t, left);
+	}
+}
+
+/* returns nonzero if reading failed */
+int tail_error(const tail *t)
+{
+	return(t->error);
+}
@@ -0,0 +1,293 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* String interning. Every distinct string is stored exactly once in a pool;
+ * interning a string returns the canonical copy, so interned strings can be
+ * compared by pointer. The strings live in large arena blocks and are found
+ * through an open-addressing (linear probing) hash table. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+#include <string.h>
+#include "intern.h"
+
+#define INTERN_MIN_SLOTS 64
+
+/* FNV-1a parameters matching the width of unsigned long */
+#if ULONG_MAX > 0xffffffffUL
+#define FNV_OFFSET 14695981039346656037UL
+#define FNV_PRIME  1099511628211UL
+#define FNV_FOLD   32
+#else
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME  16777619UL
+#define FNV_FOLD   16
+#endif
+
+/* FNV-1a */
+static unsigned long intern_hash(const char *s, size_t len)
+{
+	unsigned long h = FNV_OFFSET;
+
+	while(len--) {
+		h ^= (unsigned char)*s++;
+		h *= FNV_PRIME;
+	}
+
+	/* the low bits of the product only depend on the low bits of the
+	 * input, but they are what the table is indexed with */
+	h ^= h >> FNV_FOLD;
+
+	return(h);
+}
+
+/* find the slot holding s or the empty slot where it belongs */
+static intern_entry *intern_find(intern_pool *p, const char *s, size_t len,
+				 unsigned long h)
+{
+	size_t mask = p->slots - 1, i = h & mask;
+	intern_entry *e;
+
+	for(;;) {
+		e = &p->table[i];
+		p->stats.probes++;
+
+		if(e->str == NULL)
+			return(e);
+
+		if(e->hash == h && e->len == len && memcmp(e->str, s, len) == 0)
+			return(e);
+
+		i = (i + 1) & mask;
+	}
+}
+
+/* double the table size; stored hashes make rehashing cheap */
+static int intern_grow(intern_pool *p)
+{
+	intern_entry *old = p->table, *e;
+	size_t i, n = p->slots;
+
+	if((p->table = calloc(n * 2, sizeof(*p->table))) == NULL) {
+		p->table = old;
+		return(-1);
+	}
+
+	p->slots = n * 2;
+	p->stats.table = p->slots * sizeof(*p->table);
+
+	for(i = 0; i < n; i++) {
+		if(old[i].str == NULL)
+			continue;
+
+		e = &p->table[old[i].hash & (p->slots - 1)];
+		while(e->str != NULL) {
+			if(++e == p->table + p->slots)
+				e = p->table;
+		}
+		*e = old[i];
+	}
+
+	free(old);
+
+	return(0);
+}
+
+/* carve len bytes out of the current arena block. Strings that would waste
+ * a good part of a block get one of their own, which is linked in behind the
+ * current block so the latter keeps being filled. */
+static char *intern_alloc(intern_pool *p, size_t len)
+{
+	intern_block *b = p->blocks;
+	size_t size;
+
+	if(b == NULL || b->size - b->used < len) {
+		size = (len > INTERN_BLOCK_SIZE / 4) ? len : INTERN_BLOCK_SIZE;
+
+		if((b = malloc(sizeof(*b) + size)) == NULL)
+			return(NULL);
+
+		b->used = 0;
+		b->size = size;
+		p->stats.arena += size;
+
+		if(size == len && p->blocks != NULL) {
+			b->next = p->blocks->next;
+			p->blocks->next = b;
+		} else {
+			b->next = p->blocks;
+			p->blocks = b;
+		}
+	}
+
+	b->used += len;
+
+	return((char *)(b + 1) + b->used - len);
+}
+
+/* create a pool sized for about hint strings */
+intern_pool *intern_init(size_t hint)
+{
+	intern_pool *p;
+	size_t slots = INTERN_MIN_SLOTS;
+
+	while(slots < hint * 2)
+		slots *= 2;
+
+	if((p = malloc(sizeof(*p))) == NULL)
+		return(NULL);
+
+	if((p->table = calloc(slots, sizeof(*p->table))) == NULL) {
+		free(p);
+		return(NULL);
+	}
+
+	p->slots  = slots;
+	p->blocks = NULL;
+	memset(&p->stats, 0, sizeof(p->stats));
+	p->stats.table = slots * sizeof(*p->table);
+
+	return(p);
+}
+
+/* free the pool and all strings in it */
+void intern_destroy(intern_pool *p)
+{
+	intern_block *b;
+
+	assert(p != NULL);
+
+	while((b = p->blocks) != NULL) {
+		p->blocks = b->next;
+		free(b);
+	}
+
+	free(p->table);
+	free(p);
+}
+
+/* return the canonical copy of the first len bytes of s, adding it to the
+ * pool if necessary. The result is null-terminated. */
+const char *intern_str_n(intern_pool *p, const char *s, size_t len)
+{
+	intern_entry *e;
+	unsigned long h;
+	char *d;
+
+	assert(p != NULL);
+	assert(s != NULL);
+
+	h = intern_hash(s, len);
+	p->stats.lookups++;
+
+	e = intern_find(p, s, len, h);
+
+	if(e->str != NULL) {
+		p->stats.hits++;
+		return(e->str);
+	}
+
+	if((p->stats.strings + 1) * 2 > p->slots) {
+		if(intern_grow(p) < 0)
+			return(NULL);
+
+		e = intern_find(p, s, len, h);
+	}
+
+	if((d = intern_alloc(p, len + 1)) == NULL)
+		return(NULL);
+
+	memcpy(d, s, len);
+	d[len] = '\0';
+
+	e->str  = d;
+	e->len  = len;
+	e->hash = h;
+
+	p->stats.strings++;
+	p->stats.bytes += len + 1;
+
+	return(d);
+}
+
+/* intern a null-terminated string */
+const char *intern_str(intern_pool *p, const char *s)
+{
+	assert(s != NULL);
+
+	return(intern_str_n(p, s, strlen(s)));
+}
+
+/* return the canonical copy of s if it has been interned, NULL otherwise */
+const char *intern_lookup(intern_pool *p, const char *s, size_t len)
+{
+	intern_entry *e;
+
+	assert(p != NULL);
+	assert(s != NULL);
+
+	p->stats.lookups++;
+	e = intern_find(p, s, len, intern_hash(s, len));
+
+	if(e->str != NULL)
+		p->stats.hits++;
+
+	return(e->str);
+}
+
+/* number of distinct strings in the pool */
+size_t intern_size(const intern_pool *p)
+{
+	assert(p != NULL);
+
+	return(p->stats.strings);
+}
+
+void intern_get_stats(const intern_pool *p, intern_stats *st)
+{
+	assert(p  != NULL);
+	assert(st != NULL);
+
+	*st = p->stats;
+}
+
+void intern_print_stats(const intern_pool *p)
+{
+	const intern_stats *st;
+
+	assert(p != NULL);
+
+	st = &p->stats;
+
+	printf("strings: %lu (%lu bytes)\n", (unsigned long)st->strings,
+	       (unsigned long)st->bytes);
+	printf("memory:  %lu arena + %lu table bytes\n",
+	       (unsigned long)st->arena, (unsigned long)st->table);
+	printf("lookups: %lu (%lu hits, %.2f probes/lookup)\n",
+	       (unsigned long)st->lookups, (unsigned long)st->hits,
+	       st->lookups ? (double)st->probes / st->lookups : 0.);
+}
@@ -0,0 +1,70 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INTERN_H_
+#define INTERN_H_
+
+#define INTERN_BLOCK_SIZE 65536
+
+typedef struct intern_block_ intern_block;
+struct intern_block_ {
+	intern_block *next;
+	size_t used;
+	size_t size;
+};
+
+typedef struct intern_entry_ {
+	const char *str;
+	size_t len;
+	unsigned long hash;
+} intern_entry;
+
+typedef struct intern_stats_ {
+	size_t strings;     /* distinct strings stored */
+	size_t bytes;       /* bytes of string data, including terminators */
+	size_t arena;       /* bytes allocated for string storage */
+	size_t table;       /* bytes allocated for the hash table */
+	size_t lookups;     /* calls to intern_str() and friends */
+	size_t hits;        /* lookups that found an existing string */
+	size_t probes;      /* table slots inspected during lookups */
+} intern_stats;
+
+typedef struct intern_pool_ {
+	intern_entry *table;
+	size_t slots;
+	intern_block *blocks;
+	intern_stats stats;
+} intern_pool;
+
+intern_pool *intern_init(size_t hint);
+void         intern_destroy(intern_pool *p);
+const char  *intern_str_n(intern_pool *p, const char *s, size_t len);
+const char  *intern_str(intern_pool *p, const char *s);
+const char  *intern_lookup(intern_pool *p, const char *s, size_t len);
+size_t       intern_size(const intern_pool *p);
+void         intern_get_stats(const intern_pool *p, intern_stats *st);
+void         intern_print_stats(const intern_pool *p);
+
+#endif  /* ! INTERN_H_ */
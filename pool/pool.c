@@ -0,0 +1,116 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A minimal fork/join thread pool. pool_run() executes njobs jobs on up to
+ * nthreads threads (the calling thread included); the threads pick the next
+ * job index from a shared counter, so uneven jobs balance themselves. */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "pool.h"
+
+typedef struct {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t njobs;
+	void (*func)(void *, size_t);
+	void *arg;
+} pool;
+
+static void *pool_worker(void *arg)
+{
+	pool *p = arg;
+	size_t i;
+
+	for(;;) {
+		pthread_mutex_lock(&p->lock);
+		i = p->next++;
+		pthread_mutex_unlock(&p->lock);
+
+		if(i >= p->njobs)
+			break;
+
+		p->func(p->arg, i);
+	}
+
+	return(NULL);
+}
+
+/* number of online processors (at least 1) */
+size_t pool_cpus(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return((n < 1) ? 1 : (size_t)n);
+}
+
+/* call func(arg, i) for i = 0 .. njobs - 1 on up to nthreads threads and
+ * wait for all of them to finish. nthreads == 0 means one per processor.
+ * If threads can't be created, the remaining work is done by fewer threads
+ * (at worst by the caller alone). Returns -1 on error. */
+int pool_run(size_t njobs, size_t nthreads,
+	     void func(void *, size_t), void *arg)
+{
+	pthread_t *tids = NULL;
+	size_t i, n = 0;
+	pool p;
+
+	assert(func != NULL);
+
+	if(nthreads == 0)
+		nthreads = pool_cpus();
+
+	if(nthreads > njobs)
+		nthreads = njobs;
+
+	if(pthread_mutex_init(&p.lock, NULL) != 0)
+		return(-1);
+
+	p.next  = 0;
+	p.njobs = njobs;
+	p.func  = func;
+	p.arg   = arg;
+
+	if(nthreads > 1 && (tids = malloc((nthreads - 1) * sizeof(*tids)))) {
+		for(n = 0; n < nthreads - 1; n++)
+			if(pthread_create(&tids[n], NULL, pool_worker, &p) != 0)
+				break;
+	}
+
+	pool_worker(&p);
+
+	for(i = 0; i < n; i++)
+		pthread_join(tids[i], NULL);
+
+	free(tids);
+	pthread_mutex_destroy(&p.lock);
+
+	return(0);
+}
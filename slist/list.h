@@ -43,9 +43,12 @@ typedef struct testdat_ {
 	char str[1024];
 } testdat;
 
+struct arena_;
 
 int list_push(node_l **x, void *data);
 
+int list_push_a(struct arena_ *a, node_l **x, void *data);
+
 void *list_pop(node_l **x);
 
 int list_move(node_l **dest, node_l **src);
@@ -0,0 +1,69 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "list.h"
+#include "arena.h"
+
+
+/**
+ * @file
+ * Arena-backed list functions, apart from list.c so that it builds without
+ * arena/.
+ * @ingroup lists
+ */
+
+
+/** Adds a new node allocated from an arena to the list. Works like
+ *  list_push(), but the node is released together with the arena, so lists
+ *  built this way must not be handed to list_pop(), list_remove(),
+ *  list_delete() or list_destroy().
+ *
+ * @param _a the arena to allocate the node from
+ * @param _x reference to a list (adress might change)
+ * @param _data the data item for the new node
+ * @returns -1 on error (out of memory), 0 on success
+ *
+ * @ingroup lists
+ */
+int list_push_a(arena *a, node_l **x, void *data)
+{
+	node_l *n = NULL;
+
+	assert(a != NULL);
+	assert(x != NULL);
+
+	if((n = (node_l *)arena_alloc(a, sizeof(node_l))) == NULL) {
+		return(-1);
+	} else {
+		n->data = data;
+		n->next = *x;
+
+		*x = n;
+		return(0);
+	}
+}
@@ -0,0 +1,422 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Character classes: a compiled 256-bit byte set with a scalar table lookup
+ * and a SSSE3/AVX2 classifier. The classifier uses the low nibble of every
+ * byte to fetch its bitmap row with pshufb, picks the row of the upper or
+ * lower half of the byte range and tests the bit selected by the high
+ * nibble, i.e. it is exact for any set. The SIMD kernels are picked at
+ * runtime according to the CPU. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "charclass.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHARCLASS_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* " \t\n\v\f\r" */
+const charclass charclass_space = {{
+	{ 0x04, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x01, 0x01, 0x01, 0x01, 0, 0 },
+	{ 0 }
+}};
+
+/* "0123456789" */
+const charclass charclass_digit = {{
+	{ 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+	  0, 0, 0, 0, 0, 0 },
+	{ 0 }
+}};
+
+/* initialize cc to contain the characters of chrs (may be NULL) */
+void charclass_init(charclass *cc, const char *chrs)
+{
+	assert(cc != NULL);
+
+	memset(cc, 0, sizeof(*cc));
+
+	while(chrs && *chrs)
+		charclass_add(cc, *chrs++);
+}
+
+void charclass_add(charclass *cc, int c)
+{
+	assert(cc != NULL);
+
+	c &= 0xff;
+	cc->tbl[c >> 7][c & 0x0f] |= 1 << ((c >> 4) & 7);
+}
+
+void charclass_add_range(charclass *cc, int first, int last)
+{
+	int c;
+
+	for(c = first; c <= last; c++)
+		charclass_add(cc, c);
+}
+
+void charclass_invert(charclass *cc)
+{
+	int i;
+
+	assert(cc != NULL);
+
+	for(i = 0; i < 16; i++) {
+		cc->tbl[0][i] = (unsigned char)~cc->tbl[0][i];
+		cc->tbl[1][i] = (unsigned char)~cc->tbl[1][i];
+	}
+}
+
+
+/* scalar kernels */
+
+/* index of the first byte whose membership differs from want */
+static size_t cc_scan_scalar(const charclass *cc, const unsigned char *s,
+			     size_t len, int want)
+{
+	size_t i;
+
+	for(i = 0; i < len; i++)
+		if(charclass_has(cc, s[i]) != want)
+			break;
+
+	return(i);
+}
+
+/* number of trailing members */
+static size_t cc_rspan_scalar(const charclass *cc, const unsigned char *s,
+			      size_t len)
+{
+	size_t i = len;
+
+	while(i > 0 && charclass_has(cc, s[i - 1]))
+		--i;
+
+	return(len - i);
+}
+
+static size_t cc_replace_scalar(const charclass *cc, unsigned char *s,
+				size_t len, int c)
+{
+	size_t i, n = 0;
+
+	for(i = 0; i < len; i++) {
+		if(charclass_has(cc, s[i])) {
+			s[i] = (unsigned char)c;
+			++n;
+		}
+	}
+
+	return(n);
+}
+
+
+#ifdef CHARCLASS_SIMD
+
+/* SSSE3 kernels */
+
+#define CC_SSSE3 __attribute__((target("ssse3")))
+
+CC_SSSE3 static __m128i cc_match128(__m128i lo_tbl, __m128i hi_tbl, __m128i x)
+{
+	const __m128i nib  = _mm_set1_epi8(0x0f);
+	const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+					   1, 2, 4, 8, 16, 32, 64, -128);
+	__m128i lo, hi, row, bit, top;
+
+	lo  = _mm_and_si128(x, nib);
+	hi  = _mm_and_si128(_mm_srli_epi16(x, 4), nib);
+	top = _mm_cmplt_epi8(x, _mm_setzero_si128());
+	row = _mm_or_si128(_mm_andnot_si128(top, _mm_shuffle_epi8(lo_tbl, lo)),
+			   _mm_and_si128(top, _mm_shuffle_epi8(hi_tbl, lo)));
+	bit = _mm_shuffle_epi8(bits, hi);
+
+	return(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+}
+
+CC_SSSE3 static size_t cc_scan_ssse3(const charclass *cc,
+				     const unsigned char *s,
+				     size_t len, int want)
+{
+	__m128i lo_tbl, hi_tbl;
+	unsigned int m, expect = want ? 0xffff : 0;
+	size_t i = 0;
+
+	lo_tbl = _mm_loadu_si128((const __m128i *)cc->tbl[0]);
+	hi_tbl = _mm_loadu_si128((const __m128i *)cc->tbl[1]);
+
+	for(; i + 16 <= len; i += 16) {
+		m = _mm_movemask_epi8(cc_match128(lo_tbl, hi_tbl,
+				_mm_loadu_si128((const __m128i *)(s + i))));
+
+		if(m != expect)
+			return(i + __builtin_ctz(m ^ expect));
+	}
+
+	return(i + cc_scan_scalar(cc, s + i, len - i, want));
+}
+
+CC_SSSE3 static size_t cc_rspan_ssse3(const charclass *cc,
+				      const unsigned char *s, size_t len)
+{
+	__m128i lo_tbl, hi_tbl;
+	unsigned int m;
+	size_t i = len;
+
+	lo_tbl = _mm_loadu_si128((const __m128i *)cc->tbl[0]);
+	hi_tbl = _mm_loadu_si128((const __m128i *)cc->tbl[1]);
+
+	for(; i >= 16; i -= 16) {
+		m = _mm_movemask_epi8(cc_match128(lo_tbl, hi_tbl,
+				_mm_loadu_si128((const __m128i *)(s + i - 16))));
+
+		if(m != 0xffff)
+			return(len - i + __builtin_clz(~m << 16));
+	}
+
+	return(len - i + cc_rspan_scalar(cc, s, i));
+}
+
+CC_SSSE3 static size_t cc_replace_ssse3(const charclass *cc,
+					unsigned char *s, size_t len, int c)
+{
+	__m128i lo_tbl, hi_tbl, rep, x, m;
+	size_t i = 0, n = 0;
+
+	lo_tbl = _mm_loadu_si128((const __m128i *)cc->tbl[0]);
+	hi_tbl = _mm_loadu_si128((const __m128i *)cc->tbl[1]);
+	rep    = _mm_set1_epi8((char)c);
+
+	for(; i + 16 <= len; i += 16) {
+		x = _mm_loadu_si128((const __m128i *)(s + i));
+		m = cc_match128(lo_tbl, hi_tbl, x);
+
+		if(_mm_movemask_epi8(m) == 0)
+			continue;
+
+		n += __builtin_popcount(_mm_movemask_epi8(m));
+		x  = _mm_or_si128(_mm_andnot_si128(m, x), _mm_and_si128(m, rep));
+		_mm_storeu_si128((__m128i *)(s + i), x);
+	}
+
+	return(n + cc_replace_scalar(cc, s + i, len - i, c));
+}
+
+
+/* AVX2 kernels, same as above but 32 bytes at a time */
+
+#define CC_AVX2 __attribute__((target("avx2")))
+
+CC_AVX2 static __m256i cc_match256(__m256i lo_tbl, __m256i hi_tbl, __m256i x)
+{
+	const __m256i nib  = _mm256_set1_epi8(0x0f);
+	const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+					      1, 2, 4, 8, 16, 32, 64, -128,
+					      1, 2, 4, 8, 16, 32, 64, -128,
+					      1, 2, 4, 8, 16, 32, 64, -128);
+	__m256i lo, hi, row, bit;
+
+	lo  = _mm256_and_si256(x, nib);
+	hi  = _mm256_and_si256(_mm256_srli_epi16(x, 4), nib);
+	row = _mm256_blendv_epi8(_mm256_shuffle_epi8(lo_tbl, lo),
+				 _mm256_shuffle_epi8(hi_tbl, lo), x);
+	bit = _mm256_shuffle_epi8(bits, hi);
+
+	return(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+}
+
+CC_AVX2 static void cc_load256(const charclass *cc, __m256i *lo, __m256i *hi)
+{
+	*lo = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)cc->tbl[0]));
+	*hi = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)cc->tbl[1]));
+}
+
+CC_AVX2 static size_t cc_scan_avx2(const charclass *cc,
+				   const unsigned char *s,
+				   size_t len, int want)
+{
+	__m256i lo_tbl, hi_tbl;
+	unsigned int m, expect = want ? 0xffffffffU : 0;
+	size_t i = 0;
+
+	cc_load256(cc, &lo_tbl, &hi_tbl);
+
+	for(; i + 32 <= len; i += 32) {
+		m = (unsigned int)_mm256_movemask_epi8(cc_match256(lo_tbl, hi_tbl,
+				_mm256_loadu_si256((const __m256i *)(s + i))));
+
+		if(m != expect)
+			return(i + __builtin_ctz(m ^ expect));
+	}
+
+	return(i + cc_scan_ssse3(cc, s + i, len - i, want));
+}
+
+CC_AVX2 static size_t cc_rspan_avx2(const charclass *cc,
+				    const unsigned char *s, size_t len)
+{
+	__m256i lo_tbl, hi_tbl;
+	unsigned int m;
+	size_t i = len;
+
+	cc_load256(cc, &lo_tbl, &hi_tbl);
+
+	for(; i >= 32; i -= 32) {
+		m = (unsigned int)_mm256_movemask_epi8(cc_match256(lo_tbl, hi_tbl,
+				_mm256_loadu_si256((const __m256i *)(s + i - 32))));
+
+		if(m != 0xffffffffU)
+			return(len - i + __builtin_clz(~m));
+	}
+
+	return(len - i + cc_rspan_ssse3(cc, s, i));
+}
+
+CC_AVX2 static size_t cc_replace_avx2(const charclass *cc,
+				      unsigned char *s, size_t len, int c)
+{
+	__m256i lo_tbl, hi_tbl, rep, x, m;
+	unsigned int bits;
+	size_t i = 0, n = 0;
+
+	cc_load256(cc, &lo_tbl, &hi_tbl);
+	rep = _mm256_set1_epi8((char)c);
+
+	for(; i + 32 <= len; i += 32) {
+		x    = _mm256_loadu_si256((const __m256i *)(s + i));
+		m    = cc_match256(lo_tbl, hi_tbl, x);
+		bits = (unsigned int)_mm256_movemask_epi8(m);
+
+		if(bits == 0)
+			continue;
+
+		n += __builtin_popcount(bits);
+		_mm256_storeu_si256((__m256i *)(s + i),
+				    _mm256_blendv_epi8(x, rep, m));
+	}
+
+	return(n + cc_replace_ssse3(cc, s + i, len - i, c));
+}
+
+#endif  /* CHARCLASS_SIMD */
+
+
+/* runtime dispatch */
+
+static size_t cc_scan_init(const charclass *, const unsigned char *, size_t, int);
+static size_t cc_rspan_init(const charclass *, const unsigned char *, size_t);
+static size_t cc_replace_init(const charclass *, unsigned char *, size_t, int);
+
+static size_t (*cc_scan)(const charclass *, const unsigned char *,
+			 size_t, int) = cc_scan_init;
+static size_t (*cc_rspan)(const charclass *, const unsigned char *,
+			  size_t) = cc_rspan_init;
+static size_t (*cc_replace)(const charclass *, unsigned char *,
+			    size_t, int) = cc_replace_init;
+
+static void cc_select(void)
+{
+	cc_scan    = cc_scan_scalar;
+	cc_rspan   = cc_rspan_scalar;
+	cc_replace = cc_replace_scalar;
+
+#ifdef CHARCLASS_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) {
+		cc_scan    = cc_scan_avx2;
+		cc_rspan   = cc_rspan_avx2;
+		cc_replace = cc_replace_avx2;
+	} else if(__builtin_cpu_supports("ssse3")) {
+		cc_scan    = cc_scan_ssse3;
+		cc_rspan   = cc_rspan_ssse3;
+		cc_replace = cc_replace_ssse3;
+	}
+#endif
+}
+
+static size_t cc_scan_init(const charclass *cc, const unsigned char *s,
+			   size_t len, int want)
+{
+	cc_select();
+	return(cc_scan(cc, s, len, want));
+}
+
+static size_t cc_rspan_init(const charclass *cc, const unsigned char *s,
+			    size_t len)
+{
+	cc_select();
+	return(cc_rspan(cc, s, len));
+}
+
+static size_t cc_replace_init(const charclass *cc, unsigned char *s,
+			      size_t len, int c)
+{
+	cc_select();
+	return(cc_replace(cc, s, len, c));
+}
+
+
+/* length of the initial segment of s consisting of members of cc */
+size_t charclass_span(const charclass *cc, const char *s, size_t len)
+{
+	assert(cc != NULL);
+	assert(s  != NULL || len == 0);
+
+	return(cc_scan(cc, (const unsigned char *)s, len, 1));
+}
+
+/* length of the initial segment of s consisting of non-members of cc */
+size_t charclass_cspan(const charclass *cc, const char *s, size_t len)
+{
+	assert(cc != NULL);
+	assert(s  != NULL || len == 0);
+
+	return(cc_scan(cc, (const unsigned char *)s, len, 0));
+}
+
+/* length of the final segment of s consisting of members of cc */
+size_t charclass_rspan(const charclass *cc, const char *s, size_t len)
+{
+	assert(cc != NULL);
+	assert(s  != NULL || len == 0);
+
+	return(cc_rspan(cc, (const unsigned char *)s, len));
+}
+
+/* replace all members of cc in s with c; returns the number of replacements */
+size_t charclass_replace(const charclass *cc, char *s, size_t len, int c)
+{
+	assert(cc != NULL);
+	assert(s  != NULL || len == 0);
+
+	return(cc_replace(cc, (unsigned char *)s, len, c));
+}
@@ -0,0 +1,52 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CHARCLASS_H_
+#define CHARCLASS_H_
+
+/* A set of bytes. Bit (c >> 4) & 7 of tbl[c >> 7][c & 0x0f] tells whether c
+ * is a member; this layout doubles as the lookup tables of the SIMD
+ * classifier. */
+typedef struct charclass_ {
+	unsigned char tbl[2][16];
+} charclass;
+
+#define charclass_has(cc, c) \
+	(((cc)->tbl[((unsigned char)(c)) >> 7][((unsigned char)(c)) & 0x0f] \
+	  >> ((((unsigned char)(c)) >> 4) & 7)) & 1)
+
+extern const charclass charclass_space;
+extern const charclass charclass_digit;
+
+void   charclass_init(charclass *cc, const char *chrs);
+void   charclass_add(charclass *cc, int c);
+void   charclass_add_range(charclass *cc, int first, int last);
+void   charclass_invert(charclass *cc);
+size_t charclass_span(const charclass *cc, const char *s, size_t len);
+size_t charclass_cspan(const charclass *cc, const char *s, size_t len);
+size_t charclass_rspan(const charclass *cc, const char *s, size_t len);
+size_t charclass_replace(const charclass *cc, char *s, size_t len, int c);
+
+#endif  /* ! CHARCLASS_H_ */
@@ -0,0 +1,446 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A rope for large, frequently edited texts. The text is kept in fixed-size
+ * leaves which are organized as an implicit treap (ordered by position,
+ * heap-ordered by a random priority), so inserting, erasing and replacing
+ * in the middle of the text takes expected O(log n) instead of rewriting
+ * everything behind the edit position. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "rope.h"
+
+#define NODE_SIZE(n) ((n) == NULL ? 0 : (n)->size)
+#define MIN_LEAF(n)  ((n) < ROPE_LEAF_SIZE ? (n) : ROPE_LEAF_SIZE)
+
+static void rope_update(rope_node *t)
+{
+	t->size = NODE_SIZE(t->left) + t->len + NODE_SIZE(t->right);
+}
+
+static unsigned long rope_rand(rope *r)
+{
+	r->seed = r->seed * 1664525UL + 1013904223UL;
+
+	return(r->seed ^ (r->seed >> 16));
+}
+
+static void rope_free_nodes(rope_node *t)
+{
+	if(t != NULL) {
+		rope_free_nodes(t->left);
+		rope_free_nodes(t->right);
+		free(t);
+	}
+}
+
+/* split t into the first pos characters (l) and the rest (r); a leaf that
+ * straddles pos is cut in two. Nothing is modified if we run out of memory. */
+static int rope_split(rope_node *t, size_t pos, rope_node **l, rope_node **r)
+{
+	rope_node *n;
+	size_t ls, off;
+
+	if(t == NULL) {
+		*l = *r = NULL;
+		return(0);
+	}
+
+	ls = NODE_SIZE(t->left);
+
+	if(pos <= ls) {
+		if(rope_split(t->left, pos, l, &n) < 0)
+			return(-1);
+
+		t->left = n;
+		rope_update(t);
+		*r = t;
+	} else if(pos >= ls + t->len) {
+		if(rope_split(t->right, pos - ls - t->len, &n, r) < 0)
+			return(-1);
+
+		t->right = n;
+		rope_update(t);
+		*l = t;
+	} else {
+		if((n = malloc(sizeof(*n))) == NULL)
+			return(-1);
+
+		off = pos - ls;
+
+		n->prio  = t->prio;
+		n->len   = t->len - off;
+		n->left  = NULL;
+		n->right = t->right;
+		memcpy(n->text, t->text + off, n->len);
+		rope_update(n);
+
+		t->len   = off;
+		t->right = NULL;
+		rope_update(t);
+
+		*l = t;
+		*r = n;
+	}
+
+	return(0);
+}
+
+/* concatenate two treaps */
+static rope_node *rope_merge(rope_node *a, rope_node *b)
+{
+	if(a == NULL)
+		return(b);
+
+	if(b == NULL)
+		return(a);
+
+	if(a->prio > b->prio) {
+		a->right = rope_merge(a->right, b);
+		rope_update(a);
+		return(a);
+	} else {
+		b->left = rope_merge(a, b->left);
+		rope_update(b);
+		return(b);
+	}
+}
+
+/* concatenate two treaps like rope_merge(), but first fold the leftmost leaf
+ * of b into the rightmost leaf of a if both fit into one leaf. Splitting cuts
+ * leaves in two, so without this every edit could leave a pair of
+ * half-empty leaves behind and the rope would slowly fill up with them. */
+static rope_node *rope_join(rope_node *a, rope_node *b)
+{
+	rope_node *t, *u, **p;
+	size_t n;
+
+	if(a == NULL || b == NULL)
+		return(rope_merge(a, b));
+
+	for(t = a; t->right != NULL; t = t->right)
+		;
+
+	for(p = &b; (*p)->left != NULL; p = &(*p)->left)
+		;
+
+	u = *p;
+	n = u->len;
+
+	if(t->len + n > ROPE_LEAF_SIZE)
+		return(rope_merge(a, b));
+
+	memcpy(t->text + t->len, u->text, n);
+	t->len += n;
+
+	for(t = a; t != NULL; t = t->right)
+		t->size += n;
+
+	for(t = b; t != u; t = t->left)
+		t->size -= n;
+
+	*p = u->right;
+	free(u);
+
+	return(rope_merge(a, b));
+}
+
+/* build a treap holding the first n characters of s */
+static rope_node *rope_build(rope *r, const char *s, size_t n)
+{
+	rope_node *t = NULL, *leaf;
+	size_t len;
+
+	while(n > 0) {
+		if((leaf = malloc(sizeof(*leaf))) == NULL) {
+			rope_free_nodes(t);
+			return(NULL);
+		}
+
+		len = MIN_LEAF(n);
+
+		leaf->left  = NULL;
+		leaf->right = NULL;
+		leaf->prio  = rope_rand(r);
+		leaf->len   = len;
+		memcpy(leaf->text, s, len);
+		rope_update(leaf);
+
+		t  = rope_merge(t, leaf);
+		s += len;
+		n -= len;
+	}
+
+	return(t);
+}
+
+/* insert into an existing leaf if it has room; returns 1 on success */
+static int rope_insert_leaf(rope_node *t, size_t pos, const char *s, size_t n)
+{
+	size_t ls;
+	int ok;
+
+	if(t == NULL)
+		return(0);
+
+	ls = NODE_SIZE(t->left);
+
+	if(pos < ls) {
+		ok = rope_insert_leaf(t->left, pos, s, n);
+	} else if(pos <= ls + t->len) {
+		if(t->len + n > ROPE_LEAF_SIZE)
+			return(0);
+
+		pos -= ls;
+		memmove(t->text + pos + n, t->text + pos, t->len - pos);
+		memcpy(t->text + pos, s, n);
+		t->len += n;
+		ok = 1;
+	} else {
+		ok = rope_insert_leaf(t->right, pos - ls - t->len, s, n);
+	}
+
+	if(ok)
+		t->size += n;
+
+	return(ok);
+}
+
+/* replace n characters at pos with the first m characters of s */
+static int rope_splice(rope *r, size_t pos, size_t n, const char *s, size_t m)
+{
+	rope_node *l, *mid, *gap, *rest, *ins = NULL;
+
+	if(m > 0 && (ins = rope_build(r, s, m)) == NULL)
+		return(-1);
+
+	if(rope_split(r->root, pos, &l, &rest) < 0) {
+		rope_free_nodes(ins);
+		return(-1);
+	}
+
+	if(rope_split(rest, n, &gap, &mid) < 0) {
+		r->root = rope_join(l, rest);
+		rope_free_nodes(ins);
+		return(-1);
+	}
+
+	rope_free_nodes(gap);
+	r->root = rope_join(rope_join(l, ins), mid);
+
+	return(0);
+}
+
+/* initialize an empty rope */
+void rope_init(rope *r)
+{
+	assert(r != NULL);
+
+	r->root = NULL;
+	r->seed = (unsigned long)r;
+}
+
+/* release all memory held by the rope */
+void rope_free(rope *r)
+{
+	assert(r != NULL);
+
+	rope_free_nodes(r->root);
+	r->root = NULL;
+}
+
+/* number of characters in the rope */
+size_t rope_length(const rope *r)
+{
+	assert(r != NULL);
+
+	return(NODE_SIZE(r->root));
+}
+
+/* insert the first n characters of s at position pos */
+int rope_insert(rope *r, size_t pos, const char *s, size_t n)
+{
+	assert(r != NULL);
+	assert(s != NULL || n == 0);
+	assert(pos <= rope_length(r));
+
+	if(n == 0)
+		return(0);
+
+	if(n <= ROPE_LEAF_SIZE && rope_insert_leaf(r->root, pos, s, n))
+		return(0);
+
+	return(rope_splice(r, pos, 0, s, n));
+}
+
+/* append the first n characters of s */
+int rope_append(rope *r, const char *s, size_t n)
+{
+	return(rope_insert(r, rope_length(r), s, n));
+}
+
+/* remove n characters starting at position pos */
+int rope_erase(rope *r, size_t pos, size_t n)
+{
+	assert(r != NULL);
+	assert(pos <= rope_length(r));
+
+	if(n == 0)
+		return(0);
+
+	return(rope_splice(r, pos, n, NULL, 0));
+}
+
+/* replace n characters at position pos with the first m characters of s */
+int rope_replace(rope *r, size_t pos, size_t n, const char *s, size_t m)
+{
+	assert(r != NULL);
+	assert(s != NULL || m == 0);
+	assert(pos <= rope_length(r));
+
+	return(rope_splice(r, pos, n, s, m));
+}
+
+/* return the character at position pos or -1 if pos is out of range */
+int rope_char_at(const rope *r, size_t pos)
+{
+	const rope_node *t;
+	size_t ls;
+
+	assert(r != NULL);
+
+	t = r->root;
+
+	while(t != NULL) {
+		ls = NODE_SIZE(t->left);
+
+		if(pos < ls) {
+			t = t->left;
+		} else if(pos < ls + t->len) {
+			return((unsigned char)t->text[pos - ls]);
+		} else {
+			pos -= ls + t->len;
+			t = t->right;
+		}
+	}
+
+	return(-1);
+}
+
+static size_t rope_copy_nodes(const rope_node *t, char *out,
+			      size_t pos, size_t n)
+{
+	size_t ls, len, c = 0;
+
+	if(t == NULL || n == 0)
+		return(0);
+
+	ls = NODE_SIZE(t->left);
+
+	if(pos < ls) {
+		c = rope_copy_nodes(t->left, out, pos, n);
+		pos = ls;
+	}
+
+	if(c < n && pos < ls + t->len) {
+		len = ls + t->len - pos;
+		if(len > n - c)
+			len = n - c;
+
+		memcpy(out + c, t->text + pos - ls, len);
+		c  += len;
+		pos = ls + t->len;
+	}
+
+	if(c < n)
+		c += rope_copy_nodes(t->right, out + c, pos - ls - t->len, n - c);
+
+	return(c);
+}
+
+/* copy up to n characters starting at pos to out (which is not
+ * null-terminated); returns the number of characters copied */
+size_t rope_copy(const rope *r, char *out, size_t pos, size_t n)
+{
+	assert(r   != NULL);
+	assert(out != NULL);
+
+	return(rope_copy_nodes(r->root, out, pos, n));
+}
+
+/* return a malloc'd copy of the substring of length n starting at pos */
+char *rope_substr(const rope *r, size_t pos, size_t n)
+{
+	size_t len;
+	char *d;
+
+	assert(r != NULL);
+
+	len = rope_length(r);
+
+	if(pos > len)
+		pos = len;
+
+	if(n > len - pos)
+		n = len - pos;
+
+	if((d = malloc(n + 1)) == NULL)
+		return(NULL);
+
+	d[rope_copy(r, d, pos, n)] = '\0';
+
+	return(d);
+}
+
+/* return a malloc'd, null-terminated copy of the whole text */
+char *rope_flatten(const rope *r)
+{
+	return(rope_substr(r, 0, rope_length(r)));
+}
+
+static void rope_foreach_nodes(const rope_node *t,
+			       void func(const char *, size_t, void *),
+			       void *arg)
+{
+	if(t != NULL) {
+		rope_foreach_nodes(t->left, func, arg);
+		func(t->text, t->len, arg);
+		rope_foreach_nodes(t->right, func, arg);
+	}
+}
+
+/* call func for each piece of text in order, e.g. to write the rope out
+ * without flattening it first */
+void rope_foreach(const rope *r, void func(const char *, size_t, void *),
+		  void *arg)
+{
+	assert(r    != NULL);
+	assert(func != NULL);
+
+	rope_foreach_nodes(r->root, func, arg);
+}
@@ -0,0 +1,60 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROPE_H_
+#define ROPE_H_
+
+#define ROPE_LEAF_SIZE 512
+
+typedef struct rope_node_ rope_node;
+struct rope_node_ {
+	rope_node *left;
+	rope_node *right;
+	unsigned long prio;
+	size_t size;    /* length of the whole subtree */
+	size_t len;     /* length of this node's text */
+	char text[ROPE_LEAF_SIZE];
+};
+
+typedef struct rope_ {
+	rope_node *root;
+	unsigned long seed;
+} rope;
+
+void   rope_init(rope *r);
+void   rope_free(rope *r);
+size_t rope_length(const rope *r);
+int    rope_insert(rope *r, size_t pos, const char *s, size_t n);
+int    rope_append(rope *r, const char *s, size_t n);
+int    rope_erase(rope *r, size_t pos, size_t n);
+int    rope_replace(rope *r, size_t pos, size_t n, const char *s, size_t m);
+int    rope_char_at(const rope *r, size_t pos);
+size_t rope_copy(const rope *r, char *out, size_t pos, size_t n);
+char  *rope_substr(const rope *r, size_t pos, size_t n);
+char  *rope_flatten(const rope *r);
+void   rope_foreach(const rope *r, void func(const char *, size_t, void *),
+		    void *arg);
+
+#endif  /* ! ROPE_H_ */
@@ -0,0 +1,105 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Arena-backed variants of the string functions in string.c. They live
+ * apart so that string.c builds without arena/. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "string.h"
+#include "arena.h"
+
+/* same as substr(), but the copy is allocated from arena a */
+char *substr_a(arena *a, const char *s, size_t start, size_t len)
+{
+	char *d;
+
+	assert(a != NULL);
+	assert(s != NULL);
+
+	d = arena_alloc(a, len + 1);
+
+	if(d == NULL)
+		return NULL;
+
+	strncpy(d, s + start, len);
+	d[len] = '\0';
+
+	return d;
+}
+
+/* same as substr_replace(), but the result is allocated from arena a */
+char *substr_replace_a(arena *a,
+		       const char *haystack,
+		       const char *needle,
+		       const char *replace)
+{
+	size_t len;
+	char *ret = NULL;
+
+	assert(a        != NULL);
+	assert(haystack != NULL);
+	assert(needle   != NULL);
+	assert(replace  != NULL);
+
+	len = substr_replace_compute_size(haystack, needle, replace) + 1;
+
+	ret = arena_alloc(a, len);
+
+	if(ret == NULL)
+		return NULL;
+
+	substr_replace_r(ret, haystack, needle, replace);
+
+	return ret;
+}
+
+/* same as explode(), but everything is allocated from arena a */
+char **explode_a(arena *a, const char *str, const char *delim)
+{
+	size_t len, size;
+	char *s, **p;
+
+	assert(a     != NULL);
+	assert(str   != NULL);
+	assert(delim != NULL);
+
+	size = substr_count(str, delim) + 2;
+	len  = substr_replace_compute_size(str, delim, "") + size - 1;
+
+	p = arena_alloc(a, size * sizeof(*p));
+	if(p == NULL)
+		return(NULL);
+
+	s = arena_alloc(a, len * sizeof(*s));
+	if(s == NULL)
+		return(NULL);
+
+	explode_r(p, s, str, delim);
+
+	return(p);
+}
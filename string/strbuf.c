@@ -0,0 +1,282 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A growable string buffer. Appends are amortized O(1) because the buffer
+ * grows geometrically; the contents are always null-terminated. */
+
+#define _POSIX_C_SOURCE 200112L  /* vsnprintf() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <string.h>
+#include "strbuf.h"
+
+/* initialize an empty buffer with room for at least hint characters */
+int strbuf_init(strbuf *sb, size_t hint)
+{
+	assert(sb != NULL);
+
+	sb->len  = 0;
+	sb->size = (hint < STRBUF_MIN_SIZE) ? STRBUF_MIN_SIZE : hint + 1;
+	sb->buf  = (sb->size != 0) ? malloc(sb->size) : NULL;
+
+	if(sb->buf == NULL) {
+		sb->size = 0;
+		return(-1);
+	}
+
+	*sb->buf = '\0';
+
+	return(0);
+}
+
+/* release the buffer's memory */
+void strbuf_free(strbuf *sb)
+{
+	assert(sb != NULL);
+
+	free(sb->buf);
+
+	sb->buf  = NULL;
+	sb->len  = 0;
+	sb->size = 0;
+}
+
+/* empty the buffer but keep its memory for reuse */
+void strbuf_reset(strbuf *sb)
+{
+	strbuf_truncate(sb, 0);
+}
+
+/* nonzero if s points into the buffer, which strbuf_reserve() may move */
+static int strbuf_inside(const strbuf *sb, const char *s)
+{
+	return(sb->buf != NULL && s >= sb->buf && s < sb->buf + sb->size);
+}
+
+/* make sure there's room for len more characters (plus terminator) */
+int strbuf_reserve(strbuf *sb, size_t len)
+{
+	size_t size;
+	char *p;
+
+	assert(sb != NULL);
+
+	if(sb->len + len < sb->len)
+		return(-1);
+
+	if(sb->len + len < sb->size)
+		return(0);
+
+	size = (sb->size < STRBUF_MIN_SIZE) ? STRBUF_MIN_SIZE : sb->size;
+
+	while(size <= sb->len + len) {
+		if(size * 2 < size) {
+			size = sb->len + len + 1;
+			break;
+		}
+		size *= 2;
+	}
+
+	if((p = realloc(sb->buf, size)) == NULL)
+		return(-1);
+
+	if(sb->buf == NULL)
+		*p = '\0';
+
+	sb->buf  = p;
+	sb->size = size;
+
+	return(0);
+}
+
+/* append the first n characters of s, which may be part of the buffer */
+int strbuf_append_n(strbuf *sb, const char *s, size_t n)
+{
+	size_t off = 0;
+	int inside;
+
+	assert(sb != NULL);
+	assert(s  != NULL || n == 0);
+
+	if((inside = strbuf_inside(sb, s)) != 0)
+		off = s - sb->buf;
+
+	if(strbuf_reserve(sb, n) < 0)
+		return(-1);
+
+	if(inside)
+		s = sb->buf + off;
+
+	memmove(sb->buf + sb->len, s, n);
+	sb->len += n;
+	sb->buf[sb->len] = '\0';
+
+	return(0);
+}
+
+/* append a null-terminated string */
+int strbuf_append(strbuf *sb, const char *s)
+{
+	assert(s != NULL);
+
+	return(strbuf_append_n(sb, s, strlen(s)));
+}
+
+/* append a single character */
+int strbuf_append_char(strbuf *sb, int c)
+{
+	assert(sb != NULL);
+
+	if(strbuf_reserve(sb, 1) < 0)
+		return(-1);
+
+	sb->buf[sb->len++] = (char)c;
+	sb->buf[sb->len]   = '\0';
+
+	return(0);
+}
+
+/* append formatted output; returns the number of characters appended or -1.
+ * The first attempt formats directly into the spare room, so the common case
+ * costs a single pass. */
+int strbuf_printf(strbuf *sb, const char *fmt, ...)
+{
+	va_list ap;
+	size_t avail;
+	int n;
+
+	assert(sb  != NULL);
+	assert(fmt != NULL);
+
+	if(strbuf_reserve(sb, 0) < 0)
+		return(-1);
+
+	avail = sb->size - sb->len;
+
+	va_start(ap, fmt);
+	n = vsnprintf(sb->buf + sb->len, avail, fmt, ap);
+	va_end(ap);
+
+	if(n < 0) {
+		sb->buf[sb->len] = '\0';
+		return(-1);
+	}
+
+	if((size_t)n >= avail) {
+		if(strbuf_reserve(sb, n) < 0) {
+			sb->buf[sb->len] = '\0';
+			return(-1);
+		}
+
+		va_start(ap, fmt);
+		vsnprintf(sb->buf + sb->len, (size_t)n + 1, fmt, ap);
+		va_end(ap);
+	}
+
+	sb->len += n;
+
+	return(n);
+}
+
+/* insert the first n characters of s, which may be part of the buffer, at
+ * position pos */
+int strbuf_insert(strbuf *sb, size_t pos, const char *s, size_t n)
+{
+	size_t off = 0, k;
+	int inside;
+
+	assert(sb != NULL);
+	assert(s  != NULL || n == 0);
+	assert(pos <= sb->len);
+
+	if((inside = strbuf_inside(sb, s)) != 0)
+		off = s - sb->buf;
+
+	if(strbuf_reserve(sb, n) < 0)
+		return(-1);
+
+	memmove(sb->buf + pos + n, sb->buf + pos, sb->len - pos + 1);
+
+	if(inside) {
+		/* the part of s in front of pos stayed, the rest moved up by n */
+		k = (off >= pos) ? 0 : (pos - off < n) ? pos - off : n;
+		memcpy(sb->buf + pos, sb->buf + off, k);
+		memcpy(sb->buf + pos + k, sb->buf + off + k + n, n - k);
+	} else {
+		memcpy(sb->buf + pos, s, n);
+	}
+
+	sb->len += n;
+
+	return(0);
+}
+
+/* remove n characters starting at position pos */
+void strbuf_erase(strbuf *sb, size_t pos, size_t n)
+{
+	assert(sb != NULL);
+	assert(pos <= sb->len);
+
+	if(n > sb->len - pos)
+		n = sb->len - pos;
+
+	memmove(sb->buf + pos, sb->buf + pos + n, sb->len - pos - n + 1);
+	sb->len -= n;
+}
+
+/* shorten the contents to len characters */
+void strbuf_truncate(strbuf *sb, size_t len)
+{
+	assert(sb != NULL);
+
+	if(len < sb->len) {
+		sb->len = len;
+		sb->buf[len] = '\0';
+	}
+}
+
+/* hand the (shrunk-to-fit) string over to the caller, who has to free() it.
+ * The buffer is left empty and must be initialized again before reuse. */
+char *strbuf_detach(strbuf *sb)
+{
+	char *ret;
+
+	assert(sb != NULL);
+
+	if(sb->buf == NULL)
+		return(NULL);
+
+	if((ret = realloc(sb->buf, sb->len + 1)) == NULL)
+		ret = sb->buf;
+
+	sb->buf  = NULL;
+	sb->len  = 0;
+	sb->size = 0;
+
+	return(ret);
+}
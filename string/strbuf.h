@@ -0,0 +1,50 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STRBUF_H_
+#define STRBUF_H_
+
+#define STRBUF_MIN_SIZE 16
+
+typedef struct strbuf_ {
+	char  *buf;
+	size_t len;
+	size_t size;
+} strbuf;
+
+int    strbuf_init(strbuf *sb, size_t hint);
+void   strbuf_free(strbuf *sb);
+void   strbuf_reset(strbuf *sb);
+int    strbuf_reserve(strbuf *sb, size_t len);
+int    strbuf_append_n(strbuf *sb, const char *s, size_t n);
+int    strbuf_append(strbuf *sb, const char *s);
+int    strbuf_append_char(strbuf *sb, int c);
+int    strbuf_printf(strbuf *sb, const char *fmt, ...);
+int    strbuf_insert(strbuf *sb, size_t pos, const char *s, size_t n);
+void   strbuf_erase(strbuf *sb, size_t pos, size_t n);
+void   strbuf_truncate(strbuf *sb, size_t len);
+char  *strbuf_detach(strbuf *sb);
+
+#endif  /* ! STRBUF_H_ */
@@ -30,23 +30,21 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 #include "string.h"
+#include "charclass.h"
 
 /* Remove leading whitespaces */
 char *ltrim(char *const s)
 {
-	size_t len;
-	char *cur;
+	size_t len, n;
 
 	if(s && *s) {
 		len = strlen(s);
-		cur = s;
-
-		while(*cur && isspace(*cur))
-			++cur, --len;
+		n   = charclass_span(&charclass_space, s, len);
 
-		if(s != cur)
-			memmove(s, cur, len + 1);
+		if(n)
+			memmove(s, s + n, len - n + 1);
 	}
 
 	return s;
@@ -56,16 +54,10 @@ char *ltrim(char *const s)
 char *rtrim(char *const s)
 {
 	size_t len;
-	char *cur;
 
 	if(s && *s) {
 		len = strlen(s);
-		cur = s + len - 1;
-
-		while(cur != s && isspace(*cur))
-			--cur, --len;
-
-		cur[isspace(*cur) ? 0 : 1] = '\0';
+		s[len - charclass_rspan(&charclass_space, s, len)] = '\0';
 	}
 
 	return s;
@@ -116,6 +108,34 @@ size_t substr_count(const char *haystack, const char *needle)
 	return c;
 }
 
+/* length-bounded strstr(): find needle in the first hlen bytes of haystack,
+ * neither of which has to be null-terminated */
+char *substr_find(const char *haystack, size_t hlen,
+		  const char *needle, size_t nlen)
+{
+	const char *p, *end;
+
+	assert(haystack != NULL || hlen == 0);
+	assert(needle   != NULL || nlen == 0);
+
+	if(nlen == 0)
+		return (char *)haystack;
+
+	if(hlen < nlen)
+		return NULL;
+
+	end = haystack + hlen - nlen + 1;
+
+	while((p = memchr(haystack, *needle, end - haystack)) != NULL) {
+		if(memcmp(p + 1, needle + 1, nlen - 1) == 0)
+			return (char *)p;
+
+		haystack = p + 1;
+	}
+
+	return NULL;
+}
+
 /* compute size of the string that results in replacing all occurences
  * for replace in haystack */
 size_t substr_replace_compute_size(const char *haystack,
@@ -210,6 +230,55 @@ char *substr_replace(const char *haystack,
 	return ret;
 }
 
+/* replaces all occurences of "needle" for "replace" in "s" itself, which
+ * requires "replace" not to be longer than "needle". A write cursor trails
+ * the read cursor, so this takes a single pass and no extra memory. Stores
+ * the number of replacements in "count" (if not NULL) and returns 0, or
+ * STR_ERR_RANGE without touching "s" if "replace" is longer than "needle". */
+int substr_replace_inplace(size_t *count, char *s,
+			   const char *needle, const char *replace)
+{
+	size_t len_n, len_r, c = 0;
+	char *r, *w, *m;
+
+	assert(s       != NULL);
+	assert(needle  != NULL);
+	assert(replace != NULL);
+
+	if(count != NULL)
+		*count = 0;
+
+	len_n = strlen(needle);
+	len_r = strlen(replace);
+
+	if(len_r > len_n)
+		return STR_ERR_RANGE;
+
+	if(*needle == '\0')
+		return 0;
+
+	r = w = s;
+
+	while((m = strstr(r, needle)) != NULL) {
+		if(w != r)
+			memmove(w, r, m - r);
+		w += m - r;
+
+		memcpy(w, replace, len_r);
+		w += len_r;
+		r  = m + len_n;
+		++c;
+	}
+
+	if(w != r)
+		memmove(w, r, strlen(r) + 1);
+
+	if(count != NULL)
+		*count = c;
+
+	return 0;
+}
+
 size_t par_size(char ***par)
 {
 	size_t size = 0;
@@ -324,39 +393,143 @@ char **explode(const char *str, const char *delim)
 /* check whether str only contains digits, preceeded by +/- */
 int isint(const char *str)
 {
-	char *p = (char *)str;
+	const char *p = str;
+	size_t len;
 
-	if(p == NULL)
+	if(p == NULL || *p == '\0')
 		return 0;
 
-	while(*p) {
-		if(!isdigit(*p)) {
-			if(p != str)
-				return 0;
+	if(*p == '+' || *p == '-')
+		++p;
 
-			if((*p != '+') && (*p != '-'))
-				return 0;
-		}
+	len = strlen(p);
+
+	return charclass_span(&charclass_digit, p, len) == len;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define STR_SWAR 1
+#endif
+
+#ifdef STR_SWAR
+/* check whether the 8 bytes in v are all ASCII digits */
+static int str_is_8digits(uint64_t v)
+{
+	return(((v & UINT64_C(0xF0F0F0F0F0F0F0F0)) |
+		(((v + UINT64_C(0x0606060606060606)) &
+		  UINT64_C(0xF0F0F0F0F0F0F0F0)) >> 4)) ==
+	       UINT64_C(0x3333333333333333));
+}
+
+/* convert 8 ASCII digits (first digit in the lowest byte) in three
+ * multiplications instead of eight */
+static uint64_t str_parse_8digits(uint64_t v)
+{
+	v = ((v & UINT64_C(0x0F0F0F0F0F0F0F0F)) * 2561) >> 8;
+	v = ((v & UINT64_C(0x00FF00FF00FF00FF)) * 6553601) >> 16;
+
+	return(((v & UINT64_C(0x0000FFFF0000FFFF)) *
+		UINT64_C(42949672960001)) >> 32);
+}
+#endif
+
+/* convert len digits, 8 at a time as long as possible */
+static int str_parse_digits(uint64_t *val, const char *s, size_t len)
+{
+	uint64_t v = 0;
+	unsigned int d;
+	int ovf = 0;
+#ifdef STR_SWAR
+	uint64_t chunk;
+#endif
+
+	if(len == 0)
+		return STR_ERR_SYNTAX;
+
+#ifdef STR_SWAR
+	for(; len >= 8; s += 8, len -= 8) {
+		memcpy(&chunk, s, 8);
+
+		if(!str_is_8digits(chunk))
+			break;
+
+		chunk = str_parse_8digits(chunk);
 
-		p++;
+		if(v > (UINT64_MAX - chunk) / 100000000)
+			ovf = 1;
+		else
+			v = v * 100000000 + chunk;
 	}
+#endif
 
-	if(str == p)
-		return 0;
+	for(; len > 0; ++s, --len) {
+		d = (unsigned char)*s - '0';
+
+		if(d > 9)
+			return STR_ERR_SYNTAX;
+
+		if(v > (UINT64_MAX - d) / 10)
+			ovf = 1;
+		else
+			v = v * 10 + d;
+	}
+
+	if(ovf)
+		return STR_ERR_RANGE;
 
-	return 1;
+	*val = v;
+
+	return 0;
+}
+
+/* validate and convert the len characters at s (which need not be
+ * null-terminated) in one pass. They have to form a decimal number with an
+ * optional leading '+'. Returns 0 on success, STR_ERR_SYNTAX if s is not a
+ * number or STR_ERR_RANGE if it doesn't fit in 64 bits; val is left alone
+ * on error. */
+int str_parse_uint64(uint64_t *val, const char *s, size_t len)
+{
+	assert(val != NULL);
+	assert(s   != NULL || len == 0);
+
+	if(len > 0 && *s == '+')
+		++s, --len;
+
+	return str_parse_digits(val, s, len);
+}
+
+/* same as str_parse_uint64(), but for signed numbers; a leading '-' is
+ * allowed as well */
+int str_parse_int64(int64_t *val, const char *s, size_t len)
+{
+	uint64_t v;
+	int neg = 0, ret;
+
+	assert(val != NULL);
+	assert(s   != NULL || len == 0);
+
+	if(len > 0 && (*s == '+' || *s == '-'))
+		neg = (*s == '-'), ++s, --len;
+
+	if((ret = str_parse_digits(&v, s, len)) < 0)
+		return ret;
+
+	if(v > (uint64_t)INT64_MAX + neg)
+		return STR_ERR_RANGE;
+
+	*val = neg ? -(int64_t)(v - 1) - 1 : (int64_t)v;
+
+	return 0;
 }
 
 /* replaces occurrences of any of the chars in "chrs" with "c" */
 void str_unify(char *s, const char *chrs, int c)
 {
-	char *p = s;
-
-	while(p && *p) {
-		if(strchr(chrs, *p) != NULL)
-			*p = c;
+	charclass cc;
 
-		++p;
+	if(s && *s) {
+		charclass_init(&cc, chrs);
+		charclass_replace(&cc, s, strlen(s), c);
 	}
 }
 
@@ -26,11 +26,21 @@
 #ifndef STRING_H_
 #define STRING_H_
 
+#include <stdint.h>
+
+#define STR_ERR_SYNTAX (-1)
+#define STR_ERR_RANGE  (-2)
+
+struct arena_;
+
 char *ltrim(char *const s);
 char *rtrim(char *const s);
 char *trim(char *const s);
 char *substr(const char *s, size_t start, size_t len);
+char *substr_a(struct arena_ *a, const char *s, size_t start, size_t len);
 size_t substr_count(const char *haystack, const char *needle);
+char *substr_find(const char *haystack, size_t hlen,
+		  const char *needle, size_t nlen);
 size_t substr_replace_compute_size(const char *haystack,
 				   const char *needle,
 				   const char *replace);
@@ -42,13 +52,22 @@ void substr_replace_r(      char *s,
 char *substr_replace(const char *haystack,
 		     const char *needle, 
 		     const char *replace);
+int substr_replace_inplace(size_t *count, char *s,
+			   const char *needle, const char *replace);
+char *substr_replace_a(struct arena_ *a,
+		       const char *haystack,
+		       const char *needle,
+		       const char *replace);
 size_t par_size(char ***par);
 int par_add(char ***par, const char *s);
 void par_foreach(char ***par, void func(void *));
 void par_free(char ***par);
 void explode_r(char **a, char *p, const char *str, const char *delim);
 char **explode(const char *str, const char *delim);
+char **explode_a(struct arena_ *a, const char *str, const char *delim);
 int isint(const char *str);
+int str_parse_uint64(uint64_t *val, const char *s, size_t len);
+int str_parse_int64(int64_t *val, const char *s, size_t len);
 void str_unify(char *s, const char *chrs, int c);
 
 #endif  /* ! STRING_H_ */
@@ -0,0 +1,296 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Parallel substr_count() and substr_replace() for very large buffers.
+ *
+ * The buffer is cut into one chunk per thread and every thread scans its
+ * chunk greedily for matches that *start* inside it (peeking up to
+ * strlen(needle) - 1 bytes into the next chunk), so a match on a border is
+ * seen by exactly one chunk. A match reaching into the next chunk may
+ * however hide matches the next chunk found on its own (think "aa" in
+ * "aaa"). This is fixed up serially: the affected chunk is rescanned from
+ * where the preceding match ended until it lands on one of the first
+ * match positions it recorded, from which on both scans agree.
+ *
+ * For replacing, the final chunk boundaries give the exact output size of
+ * every chunk; a prefix sum over them yields the offsets at which the
+ * threads write their part of the result. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "string.h"
+#include "strpar.h"
+#include "pool.h"
+
+typedef struct {
+	size_t begin;    /* the chunk covers matches starting in [begin, end) */
+	size_t end;
+	size_t from;     /* where the sequential scan enters the chunk */
+	size_t resume;   /* where it continues behind the chunk */
+	size_t count;
+	size_t out;      /* output offset (replace only) */
+	size_t nfirst;
+	size_t first[STRPAR_SYNC];
+} par_chunk;
+
+typedef struct {
+	const char *s;
+	size_t len;
+	const char *needle;
+	size_t nlen;
+	const char *replace;
+	size_t rlen;
+	char *out;
+	par_chunk *chunks;
+	size_t nchunks;
+} par_job;
+
+#define LIMIT(j, c) \
+	((c)->end + (j)->nlen - 1 < (j)->len ? (c)->end + (j)->nlen - 1 : (j)->len)
+
+/* count the matches of chunk i, scanning from its beginning */
+static void par_count_chunk(void *arg, size_t i)
+{
+	par_job *j = arg;
+	par_chunk *c = &j->chunks[i];
+	const char *p, *m, *end, *lim;
+
+	p   = j->s + c->from;
+	end = j->s + c->end;
+	lim = j->s + LIMIT(j, c);
+
+	c->count  = 0;
+	c->nfirst = 0;
+
+	while(p < end && (m = substr_find(p, lim - p, j->needle, j->nlen))) {
+		if(c->nfirst < STRPAR_SYNC)
+			c->first[c->nfirst++] = m - j->s;
+
+		++c->count;
+		p = m + j->nlen;
+	}
+
+	c->resume = ((size_t)(p - j->s) > c->end) ? (size_t)(p - j->s) : c->end;
+}
+
+/* rescan chunk c from position from (behind a match of the preceding
+ * chunk) until the scan runs into a match position recorded earlier */
+static void par_resync(par_job *j, par_chunk *c, size_t from)
+{
+	const char *p, *m, *end, *lim;
+	size_t q, k = 0, count = 0;
+
+	p   = j->s + from;
+	end = j->s + c->end;
+	lim = j->s + LIMIT(j, c);
+
+	c->from = from;
+
+	while(p < end && (m = substr_find(p, lim - p, j->needle, j->nlen))) {
+		q = m - j->s;
+
+		while(k < c->nfirst && c->first[k] < q)
+			++k;
+
+		if(k < c->nfirst && c->first[k] == q) {
+			c->count = count + c->count - k;
+			return;
+		}
+
+		++count;
+		p = m + j->nlen;
+	}
+
+	c->count  = count;
+	c->nfirst = 0;
+	c->resume = ((size_t)(p - j->s) > c->end) ? (size_t)(p - j->s) : c->end;
+}
+
+/* copy chunk i to its place in the output, replacing all matches */
+static void par_replace_chunk(void *arg, size_t i)
+{
+	par_job *j = arg;
+	par_chunk *c = &j->chunks[i];
+	const char *p, *m, *end, *lim, *stop;
+	char *d;
+
+	p    = j->s + c->from;
+	end  = j->s + c->end;
+	lim  = j->s + LIMIT(j, c);
+	stop = j->s + ((i + 1 < j->nchunks) ? j->chunks[i + 1].from : j->len);
+	d    = j->out + c->out;
+
+	while(p < end && (m = substr_find(p, lim - p, j->needle, j->nlen))) {
+		memcpy(d, p, m - p);
+		d += m - p;
+		memcpy(d, j->replace, j->rlen);
+		d += j->rlen;
+		p  = m + j->nlen;
+	}
+
+	if(p < stop)
+		memcpy(d, p, stop - p);
+}
+
+/* partition the buffer and find the matches of every chunk */
+static int par_prepare(par_job *j, size_t nthreads)
+{
+	size_t i, n, size;
+
+	if(nthreads == 0)
+		nthreads = pool_cpus();
+
+	n = j->len / STRPAR_MIN_CHUNK;
+	if(n > nthreads)
+		n = nthreads;
+	if(n == 0)
+		n = 1;
+
+	if((j->chunks = malloc(n * sizeof(*j->chunks))) == NULL)
+		return(-1);
+
+	j->nchunks = n;
+	size = j->len / n;
+
+	for(i = 0; i < n; i++) {
+		j->chunks[i].begin = i * size;
+		j->chunks[i].end   = (i + 1 == n) ? j->len : (i + 1) * size;
+		j->chunks[i].from  = j->chunks[i].begin;
+	}
+
+	if(pool_run(n, nthreads, par_count_chunk, j) < 0) {
+		free(j->chunks);
+		return(-1);
+	}
+
+	for(i = 1; i < n; i++)
+		if(j->chunks[i - 1].resume > j->chunks[i].from)
+			par_resync(j, &j->chunks[i], j->chunks[i - 1].resume);
+
+	return(0);
+}
+
+/* count occurrences of needle in the first len bytes of haystack using up to
+ * nthreads threads (0: one per processor). Counts exactly like
+ * substr_count(), i.e. non-overlapping matches from left to right. */
+size_t substr_count_parallel(const char *haystack, size_t len,
+			     const char *needle, size_t nthreads)
+{
+	size_t i, c = 0;
+	par_job j;
+
+	assert(haystack != NULL || len == 0);
+	assert(needle   != NULL);
+
+	j.s      = haystack;
+	j.len    = len;
+	j.needle = needle;
+	j.nlen   = strlen(needle);
+
+	if(j.nlen == 0)
+		return(0);
+
+	if(par_prepare(&j, nthreads) < 0) {
+		while((haystack = substr_find(haystack, len, needle, j.nlen))) {
+			++c;
+			haystack += j.nlen;
+			len = j.s + j.len - haystack;
+		}
+		return(c);
+	}
+
+	for(i = 0; i < j.nchunks; i++)
+		c += j.chunks[i].count;
+
+	free(j.chunks);
+
+	return(c);
+}
+
+/* parallel version of substr_replace() for the first len bytes of haystack,
+ * which need not be null-terminated. Returns a malloc'd, null-terminated
+ * result whose length is stored in outlen (if not NULL), or NULL on error. */
+char *substr_replace_parallel(const char *haystack, size_t len,
+			      const char *needle, const char *replace,
+			      size_t nthreads, size_t *outlen)
+{
+	size_t i, span, total = 0;
+	par_chunk *c;
+	par_job j;
+
+	assert(haystack != NULL || len == 0);
+	assert(needle   != NULL);
+	assert(replace  != NULL);
+
+	j.s       = haystack;
+	j.len     = len;
+	j.needle  = needle;
+	j.nlen    = strlen(needle);
+	j.replace = replace;
+	j.rlen    = strlen(replace);
+
+	if(j.nlen == 0) {
+		if((j.out = malloc(len + 1)) == NULL)
+			return(NULL);
+
+		memcpy(j.out, haystack, len);
+		total = len;
+	} else {
+		if(par_prepare(&j, nthreads) < 0)
+			return(NULL);
+
+		/* prefix sum of the chunks' output sizes */
+		for(i = 0; i < j.nchunks; i++) {
+			c = &j.chunks[i];
+			span = ((i + 1 < j.nchunks) ? c[1].from : len) - c->from;
+
+			c->out = total;
+			total += span - c->count * j.nlen + c->count * j.rlen;
+		}
+
+		if((j.out = malloc(total + 1)) == NULL) {
+			free(j.chunks);
+			return(NULL);
+		}
+
+		if(pool_run(j.nchunks, nthreads, par_replace_chunk, &j) < 0) {
+			free(j.chunks);
+			free(j.out);
+			return(NULL);
+		}
+
+		free(j.chunks);
+	}
+
+	j.out[total] = '\0';
+
+	if(outlen != NULL)
+		*outlen = total;
+
+	return(j.out);
+}
@@ -0,0 +1,137 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Search and replace on streams. The input is read in fixed-size blocks;
+ * the last strlen(needle) - 1 bytes of a block are carried over to the next
+ * one so that matches spanning two blocks are found, too. Memory use is
+ * constant and the I/O is strictly sequential. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "string.h"
+#include "strstream.h"
+#include "fileio.h"
+
+#define MIN_SIZE(a, b) ((size_t)(a) < (size_t)(b) ? (size_t)(a) : (size_t)(b))
+
+typedef struct {
+	long (*read)(void *ctx, void *buf, size_t len);
+	int  (*write)(void *ctx, const void *buf, size_t len);
+	void *in;
+	void *out;
+} stream_io;
+
+static int stream_replace(stream_io *io, const char *needle,
+			  const char *replace, size_t *count)
+{
+	size_t nlen, rlen, have = 0, keep, c = 0;
+	char *buf, *p, *m, *end;
+	long n;
+	int ret = -1;
+
+	nlen = strlen(needle);
+	rlen = strlen(replace);
+
+	if((buf = malloc(STRSTREAM_BLOCK_SIZE + nlen)) == NULL)
+		return(-1);
+
+	do {
+		if((n = io->read(io->in, buf + have, STRSTREAM_BLOCK_SIZE)) < 0)
+			goto out;
+
+		have += n;
+		end   = buf + have;
+		p     = buf;
+
+		while(nlen && (m = substr_find(p, end - p, needle, nlen))) {
+			if(io->write(io->out, p, m - p) < 0 ||
+			   io->write(io->out, replace, rlen) < 0)
+				goto out;
+
+			++c;
+			p = m + nlen;
+		}
+
+		/* the tail might be the beginning of a match */
+		keep = (n == 0 || nlen == 0) ? 0 : MIN_SIZE(end - p, nlen - 1);
+
+		if(io->write(io->out, p, end - p - keep) < 0)
+			goto out;
+
+		memmove(buf, end - keep, keep);
+		have = keep;
+	} while(n > 0);
+
+	if(count != NULL)
+		*count = c;
+
+	ret = 0;
+out:
+	free(buf);
+
+	return(ret);
+}
+
+/* copy in to out, replacing all occurences of needle for replace; the number
+ * of replacements is stored in count (if not NULL). Returns -1 on error. */
+int substr_replace_stream(FILE *out, FILE *in,
+			  const char *needle, const char *replace,
+			  size_t *count)
+{
+	stream_io io;
+
+	assert(out     != NULL);
+	assert(in      != NULL);
+	assert(needle  != NULL);
+	assert(replace != NULL);
+
+	io.read  = file_read_block;
+	io.write = file_write_block;
+	io.in    = in;
+	io.out   = out;
+
+	return(stream_replace(&io, needle, replace, count));
+}
+
+/* same as substr_replace_stream(), but on file descriptors */
+int substr_replace_fd(int out, int in,
+		      const char *needle, const char *replace,
+		      size_t *count)
+{
+	stream_io io;
+
+	assert(needle  != NULL);
+	assert(replace != NULL);
+
+	io.read  = file_read_block_fd;
+	io.write = file_write_block_fd;
+	io.in    = &in;
+	io.out   = &out;
+
+	return(stream_replace(&io, needle, replace, count));
+}
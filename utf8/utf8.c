@@ -0,0 +1,609 @@
+/*  Copyright (c) 2009, Philip Busch <philip@0xe3.com>
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* UTF-8 utilities: validation, counting, decoding and simple case folding.
+ *
+ * Validation follows the lookup algorithm by Keiser and Lemire ("Validating
+ * UTF-8 In Less Than One Instruction Per Byte", 2021): three pshufb table
+ * lookups on the high and low nibble of the previous byte and the high
+ * nibble of the current byte classify every two-byte pair into error
+ * classes, and saturated subtractions check that three- and four-byte
+ * sequences are followed by the right number of continuation bytes. Pure
+ * ASCII blocks skip all of that. SSSE3 and AVX2 versions are picked at
+ * runtime; other CPUs use the scalar code.
+ *
+ * Case folding is simple (length-preserving) folding for ASCII, Latin-1,
+ * Latin Extended-A, Greek and Cyrillic; all other characters fold to
+ * themselves. ASCII runs are folded 16 bytes at a time. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "utf8.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define ASCII_MASK ((~0UL / 255) * 0x80)
+
+#define IS_CONT(c) (((c) & 0xc0) == 0x80)
+
+/* true if the next sizeof(long) bytes are ASCII */
+static int utf8_ascii_word(const unsigned char *s)
+{
+	unsigned long w;
+
+	memcpy(&w, s, sizeof(w));
+
+	return((w & ASCII_MASK) == 0);
+}
+
+
+/* scalar kernels */
+
+static int utf8_valid_scalar(const unsigned char *s, size_t len)
+{
+	size_t i = 0;
+	unsigned char c;
+
+	while(i < len) {
+		if(i + sizeof(long) <= len && utf8_ascii_word(s + i)) {
+			i += sizeof(long);
+			continue;
+		}
+
+		c = s[i];
+
+		if(c < 0x80) {
+			i += 1;
+		} else if(c < 0xc2) {
+			return(0);
+		} else if(c < 0xe0) {
+			if(i + 1 >= len || !IS_CONT(s[i + 1]))
+				return(0);
+			i += 2;
+		} else if(c < 0xf0) {
+			if(i + 2 >= len || !IS_CONT(s[i + 1]) || !IS_CONT(s[i + 2]))
+				return(0);
+			if((c == 0xe0 && s[i + 1] < 0xa0) ||   /* overlong */
+			   (c == 0xed && s[i + 1] > 0x9f))     /* surrogate */
+				return(0);
+			i += 3;
+		} else if(c < 0xf5) {
+			if(i + 3 >= len || !IS_CONT(s[i + 1]) ||
+			   !IS_CONT(s[i + 2]) || !IS_CONT(s[i + 3]))
+				return(0);
+			if((c == 0xf0 && s[i + 1] < 0x90) ||   /* overlong */
+			   (c == 0xf4 && s[i + 1] > 0x8f))     /* > U+10FFFF */
+				return(0);
+			i += 4;
+		} else {
+			return(0);
+		}
+	}
+
+	return(1);
+}
+
+static size_t utf8_count_scalar(const unsigned char *s, size_t len)
+{
+	size_t i, n = 0;
+
+	for(i = 0; i < len; i++)
+		n += !IS_CONT(s[i]);
+
+	return(n);
+}
+
+
+#ifdef UTF8_SIMD
+
+/* error classes of the lookup algorithm */
+#define TOO_SHORT    (1 << 0)  /* lead byte not followed by continuation */
+#define TOO_LONG     (1 << 1)  /* ASCII followed by continuation */
+#define OVERLONG_3   (1 << 2)
+#define TOO_LARGE    (1 << 3)
+#define SURROGATE    (1 << 4)
+#define OVERLONG_2   (1 << 5)
+#define TOO_LARGE_1K (1 << 6)
+#define OVERLONG_4   (1 << 6)
+#define TWO_CONTS    (1 << 7)  /* two continuations in a row */
+#define CARRY        (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/* indexed by the high nibble of the first byte of a pair */
+static const unsigned char utf8_byte1_high[16] = {
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+	TOO_SHORT | OVERLONG_2,
+	TOO_SHORT,
+	TOO_SHORT | OVERLONG_3 | SURROGATE,
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1K | OVERLONG_4
+};
+
+/* indexed by the low nibble of the first byte of a pair */
+static const unsigned char utf8_byte1_low[16] = {
+	CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+	CARRY | OVERLONG_2,
+	CARRY,
+	CARRY,
+	CARRY | TOO_LARGE,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K | SURROGATE,
+	CARRY | TOO_LARGE | TOO_LARGE_1K,
+	CARRY | TOO_LARGE | TOO_LARGE_1K
+};
+
+/* indexed by the high nibble of the second byte of a pair */
+static const unsigned char utf8_byte2_high[16] = {
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1K | OVERLONG_4,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+/* a block ending in one of these is incomplete: the last three bytes must
+ * not start a 4-, 3- or 2-byte sequence respectively */
+static const unsigned char utf8_max_tail[32] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf
+};
+
+#define UTF8_SSSE3 __attribute__((target("ssse3")))
+#define UTF8_AVX2  __attribute__((target("avx2")))
+
+UTF8_SSSE3 static __m128i utf8_check128(__m128i x, __m128i prev)
+{
+	const __m128i nib = _mm_set1_epi8(0x0f);
+	__m128i prev1, sc, must;
+
+	prev1 = _mm_alignr_epi8(x, prev, 15);
+
+	sc = _mm_and_si128(
+		_mm_and_si128(
+			_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)utf8_byte1_high),
+					 _mm_and_si128(_mm_srli_epi16(prev1, 4), nib)),
+			_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)utf8_byte1_low),
+					 _mm_and_si128(prev1, nib))),
+		_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)utf8_byte2_high),
+				 _mm_and_si128(_mm_srli_epi16(x, 4), nib)));
+
+	must = _mm_or_si128(
+		_mm_subs_epu8(_mm_alignr_epi8(x, prev, 14), _mm_set1_epi8(0xe0 - 0x80)),
+		_mm_subs_epu8(_mm_alignr_epi8(x, prev, 13), _mm_set1_epi8(0xf0 - 0x80)));
+	must = _mm_and_si128(must, _mm_set1_epi8((char)0x80));
+
+	return(_mm_xor_si128(must, sc));
+}
+
+UTF8_SSSE3 static int utf8_valid_ssse3(const unsigned char *s, size_t len)
+{
+	__m128i x, prev, err, inc, maxv;
+	unsigned char tail[16];
+	size_t i;
+
+	prev = err = inc = _mm_setzero_si128();
+	maxv = _mm_loadu_si128((const __m128i *)(utf8_max_tail + 16));
+
+	for(i = 0; i < len; i += 16) {
+		if(i + 16 <= len) {
+			x = _mm_loadu_si128((const __m128i *)(s + i));
+		} else {
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, s + i, len - i);
+			x = _mm_loadu_si128((const __m128i *)tail);
+		}
+
+		if(_mm_movemask_epi8(x) == 0) {
+			err = _mm_or_si128(err, inc);
+			inc = _mm_setzero_si128();
+		} else {
+			err = _mm_or_si128(err, utf8_check128(x, prev));
+			inc = _mm_subs_epu8(x, maxv);
+		}
+
+		prev = x;
+	}
+
+	err = _mm_or_si128(err, inc);
+
+	return(_mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128())) == 0xffff);
+}
+
+UTF8_SSSE3 static size_t utf8_count_ssse3(const unsigned char *s, size_t len)
+{
+	const __m128i cont = _mm_set1_epi8(-65);  /* 0xbf */
+	size_t i = 0, n = 0;
+
+	for(; i + 16 <= len; i += 16)
+		n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(
+			_mm_loadu_si128((const __m128i *)(s + i)), cont)));
+
+	return(n + utf8_count_scalar(s + i, len - i));
+}
+
+UTF8_AVX2 static __m256i utf8_prev256(__m256i x, __m256i prev, int n)
+{
+	__m256i p = _mm256_permute2x128_si256(prev, x, 0x21);
+
+	switch(n) {
+		case 1:
+			return(_mm256_alignr_epi8(x, p, 15));
+		case 2:
+			return(_mm256_alignr_epi8(x, p, 14));
+		default:
+			return(_mm256_alignr_epi8(x, p, 13));
+	}
+}
+
+UTF8_AVX2 static __m256i utf8_table256(const unsigned char *tbl)
+{
+	return(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tbl)));
+}
+
+UTF8_AVX2 static __m256i utf8_check256(__m256i x, __m256i prev)
+{
+	const __m256i nib = _mm256_set1_epi8(0x0f);
+	__m256i prev1, sc, must;
+
+	prev1 = utf8_prev256(x, prev, 1);
+
+	sc = _mm256_and_si256(
+		_mm256_and_si256(
+			_mm256_shuffle_epi8(utf8_table256(utf8_byte1_high),
+					    _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib)),
+			_mm256_shuffle_epi8(utf8_table256(utf8_byte1_low),
+					    _mm256_and_si256(prev1, nib))),
+		_mm256_shuffle_epi8(utf8_table256(utf8_byte2_high),
+				    _mm256_and_si256(_mm256_srli_epi16(x, 4), nib)));
+
+	must = _mm256_or_si256(
+		_mm256_subs_epu8(utf8_prev256(x, prev, 2), _mm256_set1_epi8(0xe0 - 0x80)),
+		_mm256_subs_epu8(utf8_prev256(x, prev, 3), _mm256_set1_epi8(0xf0 - 0x80)));
+	must = _mm256_and_si256(must, _mm256_set1_epi8((char)0x80));
+
+	return(_mm256_xor_si256(must, sc));
+}
+
+UTF8_AVX2 static int utf8_valid_avx2(const unsigned char *s, size_t len)
+{
+	__m256i x, prev, err, inc, maxv;
+	unsigned char tail[32];
+	size_t i;
+
+	prev = err = inc = _mm256_setzero_si256();
+	maxv = _mm256_loadu_si256((const __m256i *)utf8_max_tail);
+
+	for(i = 0; i < len; i += 32) {
+		if(i + 32 <= len) {
+			x = _mm256_loadu_si256((const __m256i *)(s + i));
+		} else {
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, s + i, len - i);
+			x = _mm256_loadu_si256((const __m256i *)tail);
+		}
+
+		if(_mm256_movemask_epi8(x) == 0) {
+			err = _mm256_or_si256(err, inc);
+			inc = _mm256_setzero_si256();
+		} else {
+			err = _mm256_or_si256(err, utf8_check256(x, prev));
+			inc = _mm256_subs_epu8(x, maxv);
+		}
+
+		prev = x;
+	}
+
+	err = _mm256_or_si256(err, inc);
+
+	return(_mm256_testz_si256(err, err));
+}
+
+UTF8_AVX2 static size_t utf8_count_avx2(const unsigned char *s, size_t len)
+{
+	const __m256i cont = _mm256_set1_epi8(-65);  /* 0xbf */
+	size_t i = 0, n = 0;
+
+	for(; i + 32 <= len; i += 32)
+		n += __builtin_popcount((unsigned int)_mm256_movemask_epi8(
+			_mm256_cmpgt_epi8(_mm256_loadu_si256(
+				(const __m256i *)(s + i)), cont)));
+
+	return(n + utf8_count_ssse3(s + i, len - i));
+}
+
+#endif  /* UTF8_SIMD */
+
+
+/* runtime dispatch */
+
+static int    utf8_valid_init(const unsigned char *, size_t);
+static size_t utf8_count_init(const unsigned char *, size_t);
+
+static int    (*utf8_valid_fn)(const unsigned char *, size_t) = utf8_valid_init;
+static size_t (*utf8_count_fn)(const unsigned char *, size_t) = utf8_count_init;
+
+static void utf8_select(void)
+{
+	utf8_valid_fn = utf8_valid_scalar;
+	utf8_count_fn = utf8_count_scalar;
+
+#ifdef UTF8_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) {
+		utf8_valid_fn = utf8_valid_avx2;
+		utf8_count_fn = utf8_count_avx2;
+	} else if(__builtin_cpu_supports("ssse3")) {
+		utf8_valid_fn = utf8_valid_ssse3;
+		utf8_count_fn = utf8_count_ssse3;
+	}
+#endif
+}
+
+static int utf8_valid_init(const unsigned char *s, size_t len)
+{
+	utf8_select();
+	return(utf8_valid_fn(s, len));
+}
+
+static size_t utf8_count_init(const unsigned char *s, size_t len)
+{
+	utf8_select();
+	return(utf8_count_fn(s, len));
+}
+
+
+/* check whether the len bytes at s are well-formed UTF-8 (no overlong
+ * forms, surrogates or code points above U+10FFFF) */
+int utf8_valid(const char *s, size_t len)
+{
+	assert(s != NULL || len == 0);
+
+	return(utf8_valid_fn((const unsigned char *)s, len));
+}
+
+/* number of code points in the (valid) UTF-8 string s */
+size_t utf8_count(const char *s, size_t len)
+{
+	assert(s != NULL || len == 0);
+
+	return(utf8_count_fn((const unsigned char *)s, len));
+}
+
+/* decode the code point at s into cp and return its length in bytes (0 if
+ * len is 0). A malformed sequence yields its first byte as code point. */
+size_t utf8_decode(unsigned long *cp, const char *s, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	size_t n, i;
+
+	assert(cp != NULL);
+	assert(s  != NULL || len == 0);
+
+	if(len == 0)
+		return(0);
+
+	if(p[0] < 0x80) {
+		*cp = p[0];
+		return(1);
+	}
+
+	if(p[0] >= 0xc2 && p[0] < 0xe0) {
+		n = 2;
+		*cp = p[0] & 0x1f;
+	} else if(p[0] >= 0xe0 && p[0] < 0xf0) {
+		n = 3;
+		*cp = p[0] & 0x0f;
+	} else if(p[0] >= 0xf0 && p[0] < 0xf5) {
+		n = 4;
+		*cp = p[0] & 0x07;
+	} else {
+		*cp = p[0];
+		return(1);
+	}
+
+	if(n > len || !utf8_valid_scalar(p, n)) {
+		*cp = p[0];
+		return(1);
+	}
+
+	for(i = 1; i < n; i++)
+		*cp = (*cp << 6) | (p[i] & 0x3f);
+
+	return(n);
+}
+
+/* simple case folding of a single code point */
+unsigned long utf8_fold_cp(unsigned long cp)
+{
+	if(cp < 0x80)
+		return((cp >= 'A' && cp <= 'Z') ? cp + 0x20 : cp);
+
+	/* Latin-1 Supplement */
+	if(cp >= 0xc0 && cp <= 0xde && cp != 0xd7)
+		return(cp + 0x20);
+
+	/* Latin Extended-A: mostly upper/lower pairs */
+	if((cp >= 0x100 && cp <= 0x12f) || (cp >= 0x132 && cp <= 0x137) ||
+	   (cp >= 0x14a && cp <= 0x177))
+		return(cp | 1);
+
+	if((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17e))
+		return((cp & 1) ? cp + 1 : cp);
+
+	if(cp == 0x178)
+		return(0xff);
+
+	/* Greek */
+	if(cp >= 0x391 && cp <= 0x3a9 && cp != 0x3a2)
+		return(cp + 0x20);
+
+	/* Cyrillic */
+	if(cp >= 0x400 && cp <= 0x40f)
+		return(cp + 0x50);
+
+	if(cp >= 0x410 && cp <= 0x42f)
+		return(cp + 0x20);
+
+	return(cp);
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* fold 16 ASCII characters */
+static __m128i utf8_fold_ascii16(__m128i x)
+{
+	__m128i upper;
+
+	upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)),
+			      _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+
+	return(_mm_add_epi8(x, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+#endif
+
+/* fold the case of the UTF-8 string s in place (folding never changes the
+ * encoded length); returns the number of bytes changed */
+size_t utf8_fold(char *s, size_t len)
+{
+	unsigned char *p = (unsigned char *)s;
+	unsigned long cp, f;
+	size_t i = 0, n, c = 0;
+#ifdef __SSE2__
+	__m128i x, y;
+#endif
+
+	assert(s != NULL || len == 0);
+
+	while(i < len) {
+#ifdef __SSE2__
+		if(i + 16 <= len) {
+			x = _mm_loadu_si128((const __m128i *)(p + i));
+
+			if(_mm_movemask_epi8(x) == 0) {
+				y = utf8_fold_ascii16(x);
+				c += __builtin_popcount(0xffff ^
+					_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+				_mm_storeu_si128((__m128i *)(p + i), y);
+				i += 16;
+				continue;
+			}
+		}
+#endif
+		if(p[i] < 0x80) {
+			if(p[i] >= 'A' && p[i] <= 'Z') {
+				p[i] += 0x20;
+				++c;
+			}
+			++i;
+			continue;
+		}
+
+		n = utf8_decode(&cp, s + i, len - i);
+
+		/* everything we fold is two bytes wide before and after */
+		if(n == 2 && (f = utf8_fold_cp(cp)) != cp) {
+			p[i]     = (unsigned char)(0xc0 | (f >> 6));
+			p[i + 1] = (unsigned char)(0x80 | (f & 0x3f));
+			c += 2;
+		}
+
+		i += n;
+	}
+
+	return(c);
+}
+
+/* compare two UTF-8 strings ignoring case, like strcmp() on the folded
+ * code points */
+int utf8_casecmp(const char *a, size_t alen, const char *b, size_t blen)
+{
+	unsigned long ca, cb;
+	size_t na, nb;
+#ifdef __SSE2__
+	__m128i xa, xb;
+	unsigned int eq;
+#endif
+
+	assert(a != NULL || alen == 0);
+	assert(b != NULL || blen == 0);
+
+	while(alen > 0 && blen > 0) {
+#ifdef __SSE2__
+		if(alen >= 16 && blen >= 16) {
+			xa = _mm_loadu_si128((const __m128i *)a);
+			xb = _mm_loadu_si128((const __m128i *)b);
+
+			if(_mm_movemask_epi8(_mm_or_si128(xa, xb)) == 0) {
+				eq = _mm_movemask_epi8(_mm_cmpeq_epi8(
+					utf8_fold_ascii16(xa), utf8_fold_ascii16(xb)));
+
+				if(eq == 0xffff) {
+					a += 16, alen -= 16;
+					b += 16, blen -= 16;
+					continue;
+				}
+
+				na = __builtin_ctz(~eq);
+				a += na, alen -= na;
+				b += na, blen -= na;
+			}
+		}
+#endif
+		na = utf8_decode(&ca, a, alen);
+		nb = utf8_decode(&cb, b, blen);
+
+		ca = utf8_fold_cp(ca);
+		cb = utf8_fold_cp(cb);
+
+		if(ca != cb)
+			return((ca < cb) ? -1 : 1);
+
+		a += na, alen -= na;
+		b += nb, blen -= nb;
+	}
+
+	if(alen == blen)
+		return(0);
+
+	return((alen == 0) ? -1 : 1);
+}